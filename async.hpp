@@ -0,0 +1,501 @@
+#pragma once
+
+#include "nbt.hpp"
+#include "compression.hpp"
+#include "region.hpp"
+#include "thread_pool.hpp"
+
+#include <coroutine>
+#include <semaphore>
+#include <unordered_map>
+
+// Coroutine API for loading chunks from an event loop. A read is submitted through an
+// AsyncIO backend and the coroutine suspends until it completes; decompression and parsing
+// then continue on a ThreadPool, whose workers steal from each other, so a burst of chunk
+// loads is spread over every core without a thread per outstanding read.
+//
+// Task is lazy: nothing runs until it is awaited or waited for. Coroutines that are members
+// of AsyncRegion or AsyncWorld refer to their object, which must outlive them.
+
+template <typename T>
+struct TaskResult {
+	std::optional<T> value{};
+
+	template <typename U>
+	void return_value(U&& result) {
+		value.emplace(std::forward<U>(result));
+	}
+
+	T take() {
+		return std::move(*value);
+	}
+};
+
+template <>
+struct TaskResult<void> {
+	void return_void() {}
+
+	void take() {}
+};
+
+template <typename T = void>
+struct [[nodiscard]] Task {
+	struct promise_type;
+	using Handle = std::coroutine_handle<promise_type>;
+
+	// Hands control to the awaiting coroutine, or wakes the thread in wait().
+	struct FinalAwaiter {
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		std::coroutine_handle<> await_suspend(Handle handle) noexcept {
+			auto& promise = handle.promise();
+			if (promise.continuation) {
+				return promise.continuation;
+			}
+			// The waiting thread may destroy the frame as soon as it is released.
+			promise.done->release();
+			return std::noop_coroutine();
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+	struct promise_type : TaskResult<T> {
+		std::coroutine_handle<> continuation{};
+		std::binary_semaphore* done = nullptr;
+		std::exception_ptr error{};
+
+		Task get_return_object() {
+			return Task(Handle::from_promise(*this));
+		}
+
+		std::suspend_always initial_suspend() const noexcept {
+			return {};
+		}
+
+		FinalAwaiter final_suspend() const noexcept {
+			return {};
+		}
+
+		void unhandled_exception() {
+			error = std::current_exception();
+		}
+	};
+
+	Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+
+	Task& operator=(Task&& other) noexcept {
+		Task(std::move(other)).swap(*this);
+		return *this;
+	}
+
+	~Task() {
+		if (handle) {
+			handle.destroy();
+		}
+	}
+
+	bool await_ready() const noexcept {
+		return false;
+	}
+
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+		handle.promise().continuation = caller;
+		return handle;
+	}
+
+	T await_resume() {
+		auto& promise = handle.promise();
+		if (promise.error) {
+			std::rethrow_exception(promise.error);
+		}
+		return promise.take();
+	}
+
+	// Runs the task and blocks until it finishes, for callers that are not coroutines. Do not
+	// call it from a worker of a pool the task needs, which could then run out of workers.
+	T wait() {
+		std::binary_semaphore done{ 0 };
+		handle.promise().done = &done;
+		handle.resume();
+		done.acquire();
+		return await_resume();
+	}
+
+private:
+	explicit Task(Handle handle) : handle(handle) {}
+
+	void swap(Task& other) noexcept {
+		std::swap(handle, other.handle);
+	}
+
+	Handle handle{};
+};
+
+// Resumes the awaiting coroutine on a worker of `pool`, or carries on if it already is on one.
+struct Schedule {
+	ThreadPool& pool;
+
+	bool await_ready() const noexcept {
+		return pool.onWorker();
+	}
+
+	void await_suspend(std::coroutine_handle<> handle) {
+		pool.submit([handle] { handle.resume(); });
+	}
+
+	void await_resume() const noexcept {}
+};
+
+// Awaits every task concurrently and returns their results in order. All tasks are started
+// before the first result is awaited, so their reads are in flight together. The first
+// exception thrown by a task is rethrown once all of them have finished.
+template <typename T>
+struct WhenAll {
+	static_assert(!std::is_void_v<T>);
+
+	static Task<std::vector<T>> run(std::vector<Task<T>> tasks) {
+		WhenAll state(tasks.size());
+		co_await Start{ state, tasks };
+		if (state.error) {
+			std::rethrow_exception(state.error);
+		}
+		std::vector<T> results{};
+		results.reserve(state.results.size());
+		for (auto& result : state.results) {
+			results.push_back(std::move(*result));
+		}
+		co_return results;
+	}
+
+private:
+	// A coroutine that runs to completion on its own and frees itself.
+	struct Detached {
+		struct promise_type {
+			Detached get_return_object() const noexcept {
+				return {};
+			}
+
+			std::suspend_never initial_suspend() const noexcept {
+				return {};
+			}
+
+			std::suspend_never final_suspend() const noexcept {
+				return {};
+			}
+
+			void return_void() const noexcept {}
+
+			void unhandled_exception() const noexcept {
+				std::terminate();
+			}
+		};
+	};
+
+	// The awaiting coroutine holds one count itself, so that it cannot be resumed before
+	// every task has been started.
+	struct Start {
+		WhenAll& state;
+		std::vector<Task<T>>& tasks;
+
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		bool await_suspend(std::coroutine_handle<> handle) {
+			state.waiter = handle;
+			for (size_t i = 0; i < tasks.size(); ++i) {
+				join(std::move(tasks[i]), state, i);
+			}
+			return state.remaining.fetch_sub(1) != 1;
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+	explicit WhenAll(size_t count) : remaining(count + 1), results(count) {}
+
+	static Detached join(Task<T> task, WhenAll& state, size_t index) {
+		try {
+			state.results[index].emplace(co_await std::move(task));
+		} catch (...) {
+			std::lock_guard lock(state.mutex);
+			if (!state.error) {
+				state.error = std::current_exception();
+			}
+		}
+		const auto waiter = state.waiter;
+		if (state.remaining.fetch_sub(1) == 1) {
+			waiter.resume();
+		}
+	}
+
+	std::atomic<size_t> remaining;
+	std::coroutine_handle<> waiter{};
+	std::vector<std::optional<T>> results;
+	std::mutex mutex{};
+	std::exception_ptr error{};
+};
+
+template <typename T>
+Task<std::vector<T>> whenAll(std::vector<Task<T>> tasks) {
+	return WhenAll<T>::run(std::move(tasks));
+}
+
+// Pluggable file access, so that coroutines never block in a system call on the thread
+// that resumes them. submit() starts reading up to `buffer.size()` bytes at `offset` and
+// calls `done` exactly once, from any thread, with the number of bytes read (fewer at the
+// end of the file) or std::nullopt if the file could not be read. submitSize() likewise
+// reports the size of a file, or std::nullopt if it does not exist. An io_uring backend
+// submits a read or statx and calls `done` from its completion loop.
+struct AsyncIO {
+	using Callback = std::function<void(std::optional<size_t>)>;
+	using SizeCallback = std::function<void(std::optional<uint64_t>)>;
+
+	virtual ~AsyncIO() = default;
+	virtual void submit(const std::filesystem::path& file, uint64_t offset, std::span<std::byte> buffer, Callback done) = 0;
+	virtual void submitSize(const std::filesystem::path& file, SizeCallback done) = 0;
+
+	struct Read {
+		AsyncIO& io;
+		const std::filesystem::path& file;
+		uint64_t offset;
+		std::span<std::byte> buffer;
+		std::optional<size_t> result{};
+
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		// `done` may run before submit() returns, which resumes the coroutine right away.
+		void await_suspend(std::coroutine_handle<> handle) {
+			io.submit(file, offset, buffer, [this, handle](std::optional<size_t> count) {
+				result = count;
+				handle.resume();
+			});
+		}
+
+		std::optional<size_t> await_resume() const noexcept {
+			return result;
+		}
+	};
+
+	struct Size {
+		AsyncIO& io;
+		const std::filesystem::path& file;
+		std::optional<uint64_t> result{};
+
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> handle) {
+			io.submitSize(file, [this, handle](std::optional<uint64_t> size) {
+				result = size;
+				handle.resume();
+			});
+		}
+
+		std::optional<uint64_t> await_resume() const noexcept {
+			return result;
+		}
+	};
+
+	Read read(const std::filesystem::path& file, uint64_t offset, std::span<std::byte> buffer) {
+		return Read{ *this, file, offset, buffer };
+	}
+
+	Size size(const std::filesystem::path& file) {
+		return Size{ *this, file };
+	}
+};
+
+// Backend that performs each read as a blocking call on a pool, for platforms without an
+// asynchronous file API.
+struct ThreadPoolIO : AsyncIO {
+	explicit ThreadPoolIO(ThreadPool& pool) : pool(pool) {}
+
+	void submit(const std::filesystem::path& file, uint64_t offset, std::span<std::byte> buffer, Callback done) override {
+		pool.submit([file, offset, buffer, done = std::move(done)] {
+			std::ifstream stream(file, std::ios::binary);
+			if (!stream || !stream.seekg(static_cast<std::streamoff>(offset))) {
+				done(std::nullopt);
+				return;
+			}
+			stream.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+			if (stream.bad()) {
+				done(std::nullopt);
+				return;
+			}
+			done(static_cast<size_t>(stream.gcount()));
+		});
+	}
+
+	void submitSize(const std::filesystem::path& file, SizeCallback done) override {
+		pool.submit([file, done = std::move(done)] {
+			std::error_code error{};
+			const auto size = std::filesystem::file_size(file, error);
+			if (error) {
+				done(std::nullopt);
+				return;
+			}
+			done(static_cast<uint64_t>(size));
+		});
+	}
+
+private:
+	ThreadPool& pool;
+};
+
+// A region read through AsyncIO instead of a memory mapping, so that a chunk load never
+// blocks on a page fault. open() reads the location table once; each chunk is then one
+// read of its sectors.
+struct AsyncRegion {
+	static constexpr size_t SECTOR = RegionFile::SECTOR;
+
+	// Fails if the file cannot be read. A file shorter than the location table has no chunks.
+	static Task<std::optional<AsyncRegion>> open(AsyncIO& io, std::filesystem::path path) {
+		AsyncRegion region(io, std::move(path));
+		const auto count = co_await io.read(region.path, 0, region.locations);
+		if (!count.has_value()) {
+			co_return std::nullopt;
+		}
+		std::fill(region.locations.begin() + static_cast<ptrdiff_t>(*count), region.locations.end(), std::byte{ 0 });
+
+		int rx = 0;
+		int rz = 0;
+		if (std::sscanf(region.path.filename().string().c_str(), "r.%d.%d.mca", &rx, &rz) == 2) {
+			region.origin = { rx * 32, rz * 32 };
+		}
+		co_return std::move(region);
+	}
+
+	bool contains(int x, int z) const {
+		return location(x, z).has_value();
+	}
+
+	// Reads the chunk at local coordinates `x` and `z`, then decompresses and parses it on
+	// `pool`. Empty if the chunk is absent or fails to decode, as with RegionFile::read().
+	Task<std::optional<CompoundTag>> loadChunk(ThreadPool& pool, int x, int z, std::pmr::memory_resource* resource = std::pmr::get_default_resource(), NameInterner* names = nullptr) const {
+		const auto sectors = location(x, z);
+		if (!sectors.has_value()) {
+			co_return std::nullopt;
+		}
+		std::vector<std::byte> buffer(sectors->second * SECTOR);
+		const auto count = co_await io->read(path, sectors->first * SECTOR, buffer);
+		if (!count.has_value() || *count < 5) {
+			co_return std::nullopt;
+		}
+		const auto length = loadBigEndian<int32_t>(buffer.data());
+		if (length < 1 || static_cast<size_t>(length) > *count - 4) {
+			co_return std::nullopt;
+		}
+		const auto type = static_cast<uint8_t>(buffer[4]);
+		if (static_cast<RegionChunk::Compression>(type & 0x7f) == RegionChunk::Compression::CUSTOM) {
+			co_return std::nullopt;
+		}
+		if ((type & 0x80) == 0) {
+			co_await Schedule{ pool };
+			co_return readCompressed(std::span<const std::byte>(buffer).subspan(5, static_cast<size_t>(length) - 1), resource, names);
+		}
+
+		const auto file = path.parent_path() / ("c." + std::to_string(origin.first + x) + "." + std::to_string(origin.second + z) + ".mcc");
+		const auto size = co_await io->size(file);
+		if (!size.has_value()) {
+			co_return std::nullopt;
+		}
+		buffer.resize(static_cast<size_t>(*size));
+		const auto external = co_await io->read(file, 0, buffer);
+		if (external != buffer.size()) {
+			co_return std::nullopt;
+		}
+		co_await Schedule{ pool };
+		co_return readCompressed(buffer, resource, names);
+	}
+
+private:
+	AsyncRegion(AsyncIO& io, std::filesystem::path path) : io(&io), path(std::move(path)), locations(SECTOR) {}
+
+	std::optional<std::pair<size_t, size_t>> location(int x, int z) const {
+		if (x < 0 || x >= 32 || z < 0 || z >= 32) {
+			return std::nullopt;
+		}
+		const auto entry = loadBigEndian<uint32_t>(locations.data() + static_cast<size_t>(x + z * 32) * 4);
+		const size_t offset = entry >> 8;
+		const size_t count = entry & 0xff;
+		if (offset < 2 || count == 0) {
+			return std::nullopt;
+		}
+		return std::pair(offset, count);
+	}
+
+	AsyncIO* io;
+	std::filesystem::path path;
+	std::pair<int, int> origin{};
+	std::vector<std::byte> locations;
+};
+
+// The regions of a world directory, opened on first use, addressed by world chunk coordinates.
+struct AsyncWorld {
+	AsyncWorld(AsyncIO& io, ThreadPool& pool, std::filesystem::path directory, std::pmr::memory_resource* resource = std::pmr::get_default_resource(), NameInterner* names = nullptr)
+		: io(io), pool(pool), directory(std::move(directory)), resource(resource), names(names) {}
+
+	Task<std::optional<CompoundTag>> loadChunk(int x, int z) {
+		const auto region = co_await this->region(x >> 5, z >> 5);
+		if (region == nullptr) {
+			co_return std::nullopt;
+		}
+		co_return co_await region->loadChunk(pool, x & 31, z & 31, resource, names);
+	}
+
+	// The square of chunks within `radius` of (x, z), such as a player's view distance, row
+	// by row from (x - radius, z - radius). Every chunk is loaded concurrently.
+	Task<std::vector<std::optional<CompoundTag>>> loadSquare(int x, int z, int radius) {
+		std::vector<Task<std::optional<CompoundTag>>> tasks{};
+		tasks.reserve(static_cast<size_t>(2 * radius + 1) * static_cast<size_t>(2 * radius + 1));
+		for (int dz = -radius; dz <= radius; ++dz) {
+			for (int dx = -radius; dx <= radius; ++dx) {
+				tasks.push_back(loadChunk(x + dx, z + dz));
+			}
+		}
+		return whenAll(std::move(tasks));
+	}
+
+	// Forgets every opened region, so that files written since are read again.
+	void clear() {
+		std::lock_guard lock(mutex);
+		regions.clear();
+	}
+
+private:
+	// Regions that do not exist are remembered as empty. Loads that race to open the same
+	// region each read its table and the first one is kept.
+	Task<std::shared_ptr<const AsyncRegion>> region(int rx, int rz) {
+		const auto key = (static_cast<uint64_t>(static_cast<uint32_t>(rx)) << 32) | static_cast<uint32_t>(rz);
+		{
+			std::lock_guard lock(mutex);
+			if (const auto it = regions.find(key); it != regions.end()) {
+				co_return it->second;
+			}
+		}
+		const auto path = directory / ("r." + std::to_string(rx) + "." + std::to_string(rz) + ".mca");
+		std::shared_ptr<const AsyncRegion> opened{};
+		if ((co_await io.size(path)).has_value()) {
+			if (auto region = co_await AsyncRegion::open(io, path)) {
+				opened = std::make_shared<const AsyncRegion>(std::move(*region));
+			}
+		}
+		std::lock_guard lock(mutex);
+		co_return regions.try_emplace(key, std::move(opened)).first->second;
+	}
+
+	AsyncIO& io;
+	ThreadPool& pool;
+	std::filesystem::path directory;
+	std::pmr::memory_resource* resource;
+	NameInterner* names;
+	std::mutex mutex{};
+	std::unordered_map<uint64_t, std::shared_ptr<const AsyncRegion>> regions{};
+};
@@ -0,0 +1,446 @@
+// Parse and write throughput over synthetic corpora shaped like real saves. Every case
+// reports bytes/second, heap allocations per iteration and the peak RSS of the process.
+// Files in the directory named by NBT_BENCH_CORPUS (raw, gzip, zlib or LZ4) are added as
+// extra cases. See the README for build and comparison instructions.
+
+#include "../nbt.hpp"
+#include "../compression.hpp"
+#include "../snbt.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <random>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+std::atomic<size_t> allocations = 0;
+
+}
+
+// GCC pairs the replaced operators with malloc and free after inlining and warns.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size != 0 ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	const auto align = static_cast<size_t>(alignment);
+#if defined(_WIN32)
+	if (void* p = _aligned_malloc(size != 0 ? size : 1, align)) {
+		return p;
+	}
+#else
+	if (void* p = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align)) {
+		return p;
+	}
+#endif
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+#if defined(_WIN32)
+	_aligned_free(p);
+#else
+	std::free(p);
+#endif
+}
+
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept {
+	operator delete(p, alignment);
+}
+
+namespace {
+
+// Peak resident set size of the process in bytes. It never decreases, so a case only
+// raises it if it needs more memory than every case before it.
+size_t peakRss() {
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters{};
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+	return static_cast<size_t>(usage.ru_maxrss);
+#else
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+struct Corpus {
+	std::string name;
+	std::vector<std::byte> data;
+};
+
+std::vector<std::byte> encode(const CompoundTag& root) {
+	std::vector<std::byte> out{};
+	NBTWriter(out).write("", root);
+	return out;
+}
+
+ListTag doubles(std::initializer_list<double> values) {
+	ListTag list{};
+	for (auto value : values) {
+		list.emplace_back(DoubleTag{ value });
+	}
+	return list;
+}
+
+IntArrayTag uuid(std::mt19937& rng) {
+	return IntArrayTag(std::pmr::vector<int32_t>{ static_cast<int32_t>(rng()), static_cast<int32_t>(rng()), static_cast<int32_t>(rng()), static_cast<int32_t>(rng()) });
+}
+
+CompoundTag item(std::mt19937& rng, std::string_view id, int slot) {
+	CompoundTag tag{};
+	tag.emplace("Slot", ByteTag{ static_cast<int8_t>(slot) });
+	tag.emplace("id", StringTag{ std::pmr::string(id) });
+	tag.emplace("Count", ByteTag{ static_cast<int8_t>(1 + rng() % 64) });
+	return tag;
+}
+
+// 24 sections of 4096 block states packed into LONG_ARRAYs, plus heightmaps.
+Corpus chunkSections(std::mt19937& rng) {
+	ListTag sections{};
+	for (int y = -4; y < 20; ++y) {
+		CompoundTag palette_entry{};
+		palette_entry.emplace("Name", StringTag{ "minecraft:stone" });
+		ListTag palette{};
+		for (int i = 0; i < 16; ++i) {
+			palette.emplace_back(palette_entry);
+		}
+
+		std::pmr::vector<int64_t> data(256);
+		for (auto& value : data) {
+			value = static_cast<int64_t>(uint64_t{ rng() } << 32 | rng());
+		}
+		CompoundTag states{};
+		states.emplace("palette", std::move(palette));
+		states.emplace("data", LongArrayTag(std::move(data)));
+
+		CompoundTag section{};
+		section.emplace("Y", ByteTag{ static_cast<int8_t>(y) });
+		section.emplace("block_states", std::move(states));
+		section.emplace("BlockLight", ByteArrayTag(std::pmr::vector<int8_t>(2048, 0x0f)));
+		section.emplace("SkyLight", ByteArrayTag(std::pmr::vector<int8_t>(2048, 0x0f)));
+		sections.emplace_back(std::move(section));
+	}
+
+	CompoundTag heightmaps{};
+	for (auto name : { "MOTION_BLOCKING", "MOTION_BLOCKING_NO_LEAVES", "OCEAN_FLOOR", "WORLD_SURFACE" }) {
+		heightmaps.emplace(name, LongArrayTag(std::pmr::vector<int64_t>(37, 0x0100804020100804)));
+	}
+
+	CompoundTag root{};
+	root.emplace("DataVersion", IntTag{ 3465 });
+	root.emplace("xPos", IntTag{ 12 });
+	root.emplace("zPos", IntTag{ -7 });
+	root.emplace("Status", StringTag{ "minecraft:full" });
+	root.emplace("sections", std::move(sections));
+	root.emplace("Heightmaps", std::move(heightmaps));
+	return { "chunk_sections", encode(root) };
+}
+
+// A farm chunk: 2000 mobs, each a compound of a dozen small fields.
+Corpus entities(std::mt19937& rng) {
+	ListTag list{};
+	for (int i = 0; i < 2000; ++i) {
+		CompoundTag entity{};
+		entity.emplace("id", StringTag{ "minecraft:cow" });
+		entity.emplace("Pos", doubles({ rng() % 16 + 0.5, 64.0, rng() % 16 + 0.5 }));
+		entity.emplace("Motion", doubles({ 0.0, -0.0784, 0.0 }));
+		ListTag rotation{};
+		rotation.emplace_back(FloatTag{ static_cast<float>(rng() % 360) });
+		rotation.emplace_back(FloatTag{ 0.0f });
+		entity.emplace("Rotation", std::move(rotation));
+		entity.emplace("UUID", uuid(rng));
+		entity.emplace("Health", FloatTag{ 10.0f });
+		entity.emplace("Air", ShortTag{ 300 });
+		entity.emplace("OnGround", ByteTag{ 1 });
+		entity.emplace("FallDistance", FloatTag{ 0.0f });
+		entity.emplace("Fire", ShortTag{ -1 });
+		entity.emplace("Age", IntTag{ static_cast<int32_t>(rng() % 24000) });
+		entity.emplace("InLove", IntTag{ 0 });
+		list.emplace_back(std::move(entity));
+	}
+	CompoundTag root{};
+	root.emplace("DataVersion", IntTag{ 3465 });
+	root.emplace("Position", IntArrayTag(std::pmr::vector<int32_t>{ 12, -7 }));
+	root.emplace("Entities", std::move(list));
+	return { "entities", encode(root) };
+}
+
+// level.dat: one wide compound of settings, game rules and the player.
+Corpus levelDat(std::mt19937& rng) {
+	CompoundTag rules{};
+	for (int i = 0; i < 50; ++i) {
+		rules.emplace("rule" + std::to_string(i), StringTag{ i % 3 == 0 ? "false" : "true" });
+	}
+
+	ListTag inventory{};
+	for (int slot = 0; slot < 36; ++slot) {
+		inventory.emplace_back(item(rng, "minecraft:cobblestone", slot));
+	}
+
+	CompoundTag player{};
+	player.emplace("Pos", doubles({ 128.5, 70.0, -42.25 }));
+	player.emplace("Inventory", std::move(inventory));
+	player.emplace("UUID", uuid(rng));
+	player.emplace("XpLevel", IntTag{ 30 });
+	player.emplace("foodSaturationLevel", FloatTag{ 5.0f });
+
+	CompoundTag data{};
+	data.emplace("LevelName", StringTag{ "New World" });
+	data.emplace("RandomSeed", LongTag{ static_cast<int64_t>(uint64_t{ rng() } << 32 | rng()) });
+	data.emplace("Time", LongTag{ 1234567 });
+	data.emplace("DayTime", LongTag{ 6000 });
+	data.emplace("GameType", IntTag{ 0 });
+	data.emplace("hardcore", ByteTag{ 0 });
+	data.emplace("BorderSize", DoubleTag{ 5.9999968e7 });
+	data.emplace("GameRules", std::move(rules));
+	data.emplace("Player", std::move(player));
+
+	CompoundTag root{};
+	root.emplace("Data", std::move(data));
+	return { "level_dat", encode(root) };
+}
+
+// A chest of shulker boxes nested 8 deep, with 3 items in each box.
+Corpus nestedItems(std::mt19937& rng) {
+	auto container = [&](auto& self, int depth) -> CompoundTag {
+		auto tag = item(rng, depth == 0 ? "minecraft:diamond" : "minecraft:shulker_box", 0);
+		if (depth != 0) {
+			ListTag items{};
+			for (int slot = 0; slot < 3; ++slot) {
+				auto child = self(self, depth - 1);
+				child.emplace("Slot", ByteTag{ static_cast<int8_t>(slot) });
+				items.emplace_back(std::move(child));
+			}
+			CompoundTag block_entity{};
+			block_entity.emplace("Items", std::move(items));
+			CompoundTag extra{};
+			extra.emplace("BlockEntityTag", std::move(block_entity));
+			tag.emplace("tag", std::move(extra));
+		}
+		return tag;
+	};
+	ListTag chest{};
+	chest.emplace_back(container(container, 8));
+	CompoundTag root{};
+	root.emplace("id", StringTag{ "minecraft:chest" });
+	root.emplace("Items", std::move(chest));
+	return { "nested_items", encode(root) };
+}
+
+// Written books and signs: few tags, long JSON text strings.
+Corpus textHeavy(std::mt19937& rng) {
+	const std::string_view words[] = { "the ", "creeper ", "exploded ", "near ", "my ", "house ", "again ", "and ", "I ", "lost ", "everything " };
+	auto text = [&](size_t length) {
+		std::pmr::string str = "{\"text\":\"";
+		while (str.size() < length) {
+			str += words[rng() % std::size(words)];
+		}
+		str += "\"}";
+		return StringTag{ std::move(str) };
+	};
+
+	ListTag books{};
+	for (int i = 0; i < 64; ++i) {
+		ListTag pages{};
+		for (int page = 0; page < 50; ++page) {
+			pages.emplace_back(text(256 + rng() % 512));
+		}
+		CompoundTag book{};
+		book.emplace("title", StringTag{ std::pmr::string("Diary " + std::to_string(i)) });
+		book.emplace("author", StringTag{ "Steve" });
+		book.emplace("pages", std::move(pages));
+		books.emplace_back(std::move(book));
+	}
+
+	ListTag signs{};
+	for (int i = 0; i < 256; ++i) {
+		ListTag messages{};
+		for (int line = 0; line < 4; ++line) {
+			messages.emplace_back(text(24 + rng() % 40));
+		}
+		CompoundTag front{};
+		front.emplace("messages", std::move(messages));
+		front.emplace("color", StringTag{ "black" });
+		CompoundTag sign{};
+		sign.emplace("id", StringTag{ "minecraft:sign" });
+		sign.emplace("front_text", std::move(front));
+		signs.emplace_back(std::move(sign));
+	}
+
+	CompoundTag root{};
+	root.emplace("books", std::move(books));
+	root.emplace("signs", std::move(signs));
+	return { "text_heavy", encode(root) };
+}
+
+std::vector<Corpus> corpora() {
+	std::mt19937 rng(0x4e4254);
+	std::vector<Corpus> result{};
+	result.push_back(chunkSections(rng));
+	result.push_back(entities(rng));
+	result.push_back(levelDat(rng));
+	result.push_back(nestedItems(rng));
+	result.push_back(textHeavy(rng));
+
+	if (const char* dir = std::getenv("NBT_BENCH_CORPUS")) {
+		for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+			if (!entry.is_regular_file()) {
+				continue;
+			}
+			std::ifstream stream(entry.path(), std::ios::binary);
+			std::vector<std::byte> raw(entry.file_size());
+			stream.read(reinterpret_cast<char*>(raw.data()), static_cast<std::streamsize>(raw.size()));
+			if (detectCompression(raw) != Compression::NONE) {
+				auto data = decompress(raw);
+				if (!data.has_value()) {
+					continue;
+				}
+				raw.assign(data->begin(), data->end());
+			}
+			if (NBTFile(raw).read().has_value()) {
+				result.push_back({ "file:" + entry.path().filename().string(), std::move(raw) });
+			}
+		}
+	}
+	return result;
+}
+
+// Allocations are counted over the timed loop only.
+struct Counted {
+	explicit Counted(benchmark::State& state, size_t bytes) : state(state), bytes(bytes), start(allocations.load()) {}
+
+	~Counted() {
+		const auto iterations = static_cast<double>(state.iterations());
+		state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(bytes));
+		state.counters["allocs"] = benchmark::Counter(static_cast<double>(allocations.load() - start) / std::max(iterations, 1.0));
+		state.counters["peak_rss_mb"] = benchmark::Counter(static_cast<double>(peakRss()) / (1024 * 1024));
+	}
+
+	benchmark::State& state;
+	size_t bytes;
+	size_t start;
+};
+
+void benchRead(benchmark::State& state, const Corpus& corpus) {
+	Counted counted(state, corpus.data.size());
+	for (auto _ : state) {
+		auto tag = NBTFile(corpus.data).read();
+		benchmark::DoNotOptimize(tag);
+	}
+}
+
+void benchReadArena(benchmark::State& state, const Corpus& corpus) {
+	NBTDecoder decoder{};
+	const std::span<const std::byte> payload = corpus.data;
+	decoder.decodeBatch({ &payload, 1 });
+	Counted counted(state, corpus.data.size());
+	for (auto _ : state) {
+		auto tags = decoder.decodeBatch({ &payload, 1 });
+		benchmark::DoNotOptimize(tags.data());
+	}
+}
+
+void benchSkip(benchmark::State& state, const Corpus& corpus) {
+	Counted counted(state, corpus.data.size());
+	for (auto _ : state) {
+		NBTFile file(corpus.data);
+		file.readID();
+		file.readStringView();
+		benchmark::DoNotOptimize(file.skipTag(NBTFile::ID::COMPOUND));
+	}
+}
+
+void benchWrite(benchmark::State& state, const Corpus& corpus) {
+	const auto tag = NBTFile(corpus.data).read();
+	std::vector<std::byte> out{};
+	out.reserve(corpus.data.size());
+	Counted counted(state, corpus.data.size());
+	for (auto _ : state) {
+		out.clear();
+		NBTWriter(out).write(*tag);
+		benchmark::DoNotOptimize(out.data());
+	}
+}
+
+void benchReadSNBT(benchmark::State& state, const Corpus& corpus) {
+	std::string text{};
+	SNBTWriter(text).write(*NBTFile(corpus.data).read());
+	Counted counted(state, text.size());
+	for (auto _ : state) {
+		auto tag = SNBTReader(text).read();
+		benchmark::DoNotOptimize(tag);
+	}
+}
+
+void benchWriteSNBT(benchmark::State& state, const Corpus& corpus) {
+	const auto tag = NBTFile(corpus.data).read();
+	std::string out{};
+	SNBTWriter(out).write(*tag);
+	Counted counted(state, out.size());
+	for (auto _ : state) {
+		out.clear();
+		SNBTWriter(out).write(*tag);
+		benchmark::DoNotOptimize(out.data());
+	}
+}
+}
+
+int main(int argc, char** argv) {
+	static const auto cases = corpora();
+	for (const auto& corpus : cases) {
+		benchmark::RegisterBenchmark(("read/" + corpus.name).c_str(), benchRead, std::cref(corpus));
+		benchmark::RegisterBenchmark(("read_arena/" + corpus.name).c_str(), benchReadArena, std::cref(corpus));
+		benchmark::RegisterBenchmark(("skip/" + corpus.name).c_str(), benchSkip, std::cref(corpus));
+		benchmark::RegisterBenchmark(("write/" + corpus.name).c_str(), benchWrite, std::cref(corpus));
+		benchmark::RegisterBenchmark(("snbt_read/" + corpus.name).c_str(), benchReadSNBT, std::cref(corpus));
+		benchmark::RegisterBenchmark(("snbt_write/" + corpus.name).c_str(), benchWriteSNBT, std::cref(corpus));
+	}
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+		return 1;
+	}
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+#include "nbt.hpp"
+#include "region.hpp"
+
+#include <future>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+// A parsed document that cannot be modified, together with the arena that holds it. It
+// is only handed out as std::shared_ptr<const NBTDocument>, so any number of threads can
+// read the same tree at the same time, and it is freed in one piece after the last
+// reader drops its handle.
+struct NBTDocument {
+	using Handle = std::shared_ptr<const NBTDocument>;
+
+	// Parses an uncompressed document; empty if it is malformed.
+	static Handle parse(std::span<const std::byte> data, NameInterner* names = nullptr) {
+		return build([&](std::pmr::memory_resource* resource) {
+			return NBTFile(data, resource, names).read();
+		});
+	}
+
+	// Decompresses and parses chunk (x, z) of `region`, in coordinates local to the region.
+	static Handle read(const RegionFile& region, int x, int z, NameInterner* names = nullptr) {
+		return build([&](std::pmr::memory_resource* resource) {
+			return region.read(x, z, resource, names);
+		});
+	}
+
+	std::string_view name() const {
+		return std::string_view(tree->begin()->first);
+	}
+
+	const CompoundTag& root() const {
+		return std::get<CompoundTag>(tree->begin()->second);
+	}
+
+	// Bytes the arena holds, which is what the document costs in a ChunkCache budget.
+	size_t memoryUsage() const {
+		return sizeof(NBTDocument) + upstream.bytes;
+	}
+
+	// Use parse() or read().
+	struct Private {};
+	explicit NBTDocument(Private) {}
+
+private:
+	// Counts what the arena takes from the default resource.
+	struct Upstream final : std::pmr::memory_resource {
+		void* do_allocate(size_t size, size_t alignment) override {
+			bytes += size;
+			return std::pmr::get_default_resource()->allocate(size, alignment);
+		}
+
+		void do_deallocate(void* p, size_t size, size_t alignment) override {
+			std::pmr::get_default_resource()->deallocate(p, size, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+			return this == &other;
+		}
+
+		size_t bytes = 0;
+	};
+
+	template <typename F>
+	static Handle build(F&& read) {
+		auto document = std::make_shared<NBTDocument>(Private{});
+		auto tree = read(&document->arena);
+		if (!tree.has_value()) {
+			return nullptr;
+		}
+		document->tree.emplace(std::move(*tree));
+		return document;
+	}
+
+	// Declared in this order so the tree is destroyed before its arena.
+	Upstream upstream{};
+	std::pmr::monotonic_buffer_resource arena{ &upstream };
+	std::optional<CompoundTag> tree{};
+};
+
+// Absolute chunk coordinates; the region is (x >> 5, z >> 5). Use one cache per dimension.
+struct ChunkKey {
+	int x = 0;
+	int z = 0;
+
+	bool operator==(const ChunkKey&) const = default;
+};
+
+// Least recently used cache of parsed chunks, bounded by the total memoryUsage() of the
+// documents it holds. All members are thread-safe. Handles stay valid after their
+// document is evicted, and concurrent get() calls for a chunk that is not cached wait for
+// a single load instead of each parsing it. A load that is overtaken by insert(), erase()
+// or clear() of its chunk is returned to its callers but not cached.
+struct ChunkCache {
+	using Handle = NBTDocument::Handle;
+
+	explicit ChunkCache(size_t budget) : budget(budget) {}
+
+	ChunkCache(const ChunkCache&) = delete;
+	ChunkCache& operator=(const ChunkCache&) = delete;
+
+	Handle find(ChunkKey key) {
+		std::lock_guard lock(mutex);
+		return lookup(key);
+	}
+
+	// Returns the cached document, or the result of `load()`, a callable returning Handle,
+	// which is cached unless it is empty. `load` runs without the lock held.
+	template <typename F>
+	Handle get(ChunkKey key, F&& load) {
+		std::unique_lock lock(mutex);
+		if (auto document = lookup(key)) {
+			return document;
+		}
+		if (auto it = loading.find(key); it != loading.end()) {
+			auto future = it->second.result;
+			lock.unlock();
+			return future.get();
+		}
+		std::promise<Handle> promise{};
+		loading.emplace(key, Load{ promise.get_future().share() });
+		lock.unlock();
+
+		Handle document{};
+		try {
+			document = load();
+		} catch (...) {
+			lock.lock();
+			loading.erase(key);
+			lock.unlock();
+			promise.set_exception(std::current_exception());
+			throw;
+		}
+
+		lock.lock();
+		const auto pending = loading.find(key);
+		const auto stale = pending->second.stale;
+		loading.erase(pending);
+		if (document != nullptr && !stale) {
+			store(key, document);
+		}
+		lock.unlock();
+		promise.set_value(document);
+		return document;
+	}
+
+	// Loads from `region` when the chunk is not cached. `region` must be the region file
+	// that contains `key`.
+	Handle get(ChunkKey key, const RegionFile& region, NameInterner* names = nullptr) {
+		return get(key, [&] {
+			return NBTDocument::read(region, key.x & 31, key.z & 31, names);
+		});
+	}
+
+	// Replaces the cached document for `key`; an empty `document` erases it.
+	void insert(ChunkKey key, Handle document) {
+		std::lock_guard lock(mutex);
+		invalidate(key);
+		store(key, std::move(document));
+	}
+
+	void erase(ChunkKey key) {
+		std::lock_guard lock(mutex);
+		invalidate(key);
+		if (auto it = index.find(key); it != index.end()) {
+			remove(it->second);
+		}
+	}
+
+	void clear() {
+		std::lock_guard lock(mutex);
+		for (auto& entry : loading) {
+			entry.second.stale = true;
+		}
+		index.clear();
+		entries.clear();
+		used = 0;
+	}
+
+	size_t size() const {
+		std::lock_guard lock(mutex);
+		return entries.size();
+	}
+
+	size_t usage() const {
+		std::lock_guard lock(mutex);
+		return used;
+	}
+
+private:
+	struct Entry {
+		ChunkKey key;
+		Handle document;
+		size_t cost;
+	};
+
+	struct Hash {
+		size_t operator()(ChunkKey key) const {
+			return std::hash<uint64_t>{}(static_cast<uint64_t>(static_cast<uint32_t>(key.x)) << 32 | static_cast<uint32_t>(key.z));
+		}
+	};
+
+	// A load in flight; `stale` once its chunk was replaced or erased meanwhile.
+	struct Load {
+		std::shared_future<Handle> result;
+		bool stale = false;
+	};
+
+	using Entries = std::list<Entry>;
+
+	Handle lookup(ChunkKey key) {
+		auto it = index.find(key);
+		if (it == index.end()) {
+			return nullptr;
+		}
+		entries.splice(entries.begin(), entries, it->second);
+		return it->second->document;
+	}
+
+	// A document larger than the whole budget is returned to the caller but not kept.
+	void store(ChunkKey key, Handle document) {
+		if (auto it = index.find(key); it != index.end()) {
+			remove(it->second);
+		}
+		if (document == nullptr) {
+			return;
+		}
+		const auto cost = document->memoryUsage();
+		if (cost > budget) {
+			return;
+		}
+		while (used + cost > budget) {
+			remove(std::prev(entries.end()));
+		}
+		entries.push_front(Entry{ key, std::move(document), cost });
+		index.emplace(key, entries.begin());
+		used += cost;
+	}
+
+	void invalidate(ChunkKey key) {
+		if (auto it = loading.find(key); it != loading.end()) {
+			it->second.stale = true;
+		}
+	}
+
+	void remove(Entries::iterator it) {
+		used -= it->cost;
+		index.erase(it->key);
+		entries.erase(it);
+	}
+
+	const size_t budget;
+	mutable std::mutex mutex{};
+	Entries entries{};
+	std::unordered_map<ChunkKey, Entries::iterator, Hash> index{};
+	std::unordered_map<ChunkKey, Load, Hash> loading{};
+	size_t used = 0;
+};
@@ -0,0 +1,414 @@
+#pragma once
+
+#include "stream.hpp"
+
+#include <functional>
+
+// A column to export: a dot-separated path from the row compound, such as "Health" or
+// "Brain.memories", and the type to accept there. `type` is a number type, STRING, one of
+// the array types, or LIST with a number or STRING `element`. A row whose value is missing
+// or of another type gets a null.
+struct ColumnSpec {
+	std::string path;
+	TagID type;
+	TagID element = TagID::END;
+};
+
+// One column of a batch, laid out as the buffers of an Arrow array:
+// - `validity` is the bitmap, least significant bit first, with a 1 for each present row;
+// - numbers are fixed-width values in `values` (int8 to int64, float32, float64);
+// - STRING is utf8, with `length + 1` byte offsets into `values`;
+// - arrays and LISTs are list<T>, with `length + 1` offsets counting elements, the elements
+//   in `values` and, for list<utf8>, their byte offsets in `elementOffsets`.
+// A null row takes zero bytes in `values` for numbers and an empty range for the rest.
+// Strings are copied as stored, which is modified UTF-8 for Java documents; offsets are
+// 32-bit, so keep batches well under 2 GiB per column.
+struct Column {
+	ColumnSpec spec;
+	size_t length = 0;
+	size_t nulls = 0;
+	std::vector<uint8_t> validity{};
+	std::vector<int32_t> offsets{};
+	std::vector<int32_t> elementOffsets{};
+	std::vector<std::byte> values{};
+
+	bool valid(size_t row) const {
+		return (validity[row / 8] >> (row % 8) & 1) != 0;
+	}
+
+	// The values of a number column, or the elements of an array or LIST column.
+	template <typename T>
+	std::span<const T> view() const {
+		return { reinterpret_cast<const T*>(values.data()), values.size() / sizeof(T) };
+	}
+
+	std::string_view string(size_t row) const {
+		return { reinterpret_cast<const char*>(values.data()) + offsets[row], static_cast<size_t>(offsets[row + 1] - offsets[row]) };
+	}
+};
+
+struct ColumnBatch {
+	std::vector<Column> columns{};
+	size_t rows = 0;
+};
+
+// Streams documents through NBTStreamReader and appends the selected paths of every row
+// straight to column buffers, without building a tree. `rows` is the path of the rows: ""
+// for one row per document, the path of a compound, or the path of a list whose compound
+// elements are each a row, such as "Entities" or "Level.Entities".
+//
+// Each time a document brings the batch to `batchRows` rows or more, it is passed to the
+// sink and then cleared, keeping its capacity, so a long export reuses the same buffers.
+// Call flush() at the end for the last, partial batch.
+struct ColumnarExporter {
+	using ID = TagID;
+	using Sink = std::function<void(const ColumnBatch&)>;
+
+	ColumnarExporter(std::string_view rows, std::vector<ColumnSpec> specs, size_t batchRows, Sink sink) : batchRows(batchRows), sink(std::move(sink)) {
+		const auto row = insert(0, rows);
+		nodes[row].row = true;
+		for (size_t i = 0; i < specs.size(); ++i) {
+			nodes[insert(row, specs[i].path)].column = static_cast<int>(i);
+			current.columns.push_back(Column{ std::move(specs[i]) });
+		}
+		clear();
+	}
+
+	ColumnarExporter(const ColumnarExporter&) = delete;
+	ColumnarExporter& operator=(const ColumnarExporter&) = delete;
+
+	// Exports one uncompressed document. On failure the rows of this document are dropped
+	// and the batch is left as it was.
+	bool add(std::span<const std::byte> document) {
+		input = SpanSource(document);
+		reader.reset();
+		return exportRows(reader);
+	}
+
+	template <ByteSource Source>
+	bool add(Source& source) {
+		NBTStreamReader<Source> stream(source);
+		return exportRows(stream);
+	}
+
+	// Passes the rows collected so far to the sink, if there are any.
+	void flush() {
+		if (current.rows != 0) {
+			sink(current);
+			clear();
+		}
+	}
+
+	const ColumnBatch& batch() const {
+		return current;
+	}
+
+private:
+	// A path segment. Node 0 is the document root; the exported columns hang below the node
+	// marked `row`.
+	struct Node {
+		std::vector<std::pair<std::string, size_t>> children{};
+		int column = -1;
+		bool row = false;
+	};
+
+	struct Frame {
+		// Node of this compound, or null when nothing below it is exported.
+		const Node* node;
+		// LIST column this list is the value of, or -1.
+		int column;
+		bool list;
+		bool row;
+	};
+
+	struct Mark {
+		size_t length;
+		size_t nulls;
+		size_t offsets;
+		size_t elementOffsets;
+		size_t values;
+	};
+
+	struct Handler : NBTHandler {
+		explicit Handler(ColumnarExporter& exporter) : exporter(exporter) {}
+
+		void onCompoundBegin(std::string_view name) {
+			auto& frames = exporter.frames;
+			if (frames.empty()) {
+				const auto root = &exporter.nodes[0];
+				frames.push_back(Frame{ root, -1, false, root->row });
+			} else if (frames.back().list) {
+				// Only elements of the row list are looked into.
+				const auto node = frames.back().node;
+				frames.push_back(Frame{ node, -1, false, node != nullptr });
+			} else {
+				const auto node = exporter.child(name);
+				frames.push_back(Frame{ node, -1, false, node != nullptr && node->row });
+			}
+			if (frames.back().row) {
+				exporter.filled.assign(exporter.current.columns.size(), false);
+			}
+		}
+
+		void onCompoundEnd() {
+			if (exporter.frames.back().row) {
+				exporter.endRow();
+			}
+			exporter.frames.pop_back();
+		}
+
+		void onListBegin(std::string_view name, ID element, size_t count) {
+			auto& frames = exporter.frames;
+			const auto node = frames.back().list ? nullptr : exporter.child(name);
+			if (auto column = exporter.columnAt(node, ID::LIST); column >= 0) {
+				const auto& spec = exporter.current.columns[static_cast<size_t>(column)].spec;
+				if (element == spec.element || count == 0) {
+					frames.push_back(Frame{ nullptr, column, true, false });
+					return;
+				}
+			}
+			frames.push_back(Frame{ node != nullptr && node->row ? node : nullptr, -1, true, false });
+		}
+
+		void onListEnd() {
+			if (const auto column = exporter.frames.back().column; column >= 0) {
+				exporter.endList(static_cast<size_t>(column));
+			}
+			exporter.frames.pop_back();
+		}
+
+		void onArrayBegin(std::string_view name, ID id, size_t) {
+			exporter.array = exporter.frames.back().list ? -1 : exporter.columnAt(exporter.child(name), id);
+		}
+
+		void onArrayEnd() {
+			if (exporter.array >= 0) {
+				exporter.endList(static_cast<size_t>(exporter.array));
+			}
+		}
+
+		template <typename T>
+		void onArrayChunk(std::span<const T> values) {
+			if (exporter.array >= 0) {
+				exporter.append(exporter.current.columns[static_cast<size_t>(exporter.array)].values, values.data(), values.size_bytes());
+			}
+		}
+
+		template <typename T>
+		void onScalar(std::string_view name, T value) {
+			exporter.value(name, idOf<T>(), &value, sizeof(T));
+		}
+
+		void onString(std::string_view name, std::string_view value) {
+			exporter.value(name, ID::STRING, value.data(), value.size());
+		}
+
+		template <typename T>
+		static constexpr ID idOf() {
+			if constexpr (std::is_same_v<T, int8_t>) {
+				return ID::BYTE;
+			} else if constexpr (std::is_same_v<T, int16_t>) {
+				return ID::SHORT;
+			} else if constexpr (std::is_same_v<T, int32_t>) {
+				return ID::INT;
+			} else if constexpr (std::is_same_v<T, int64_t>) {
+				return ID::LONG;
+			} else if constexpr (std::is_same_v<T, float>) {
+				return ID::FLOAT;
+			} else {
+				return ID::DOUBLE;
+			}
+		}
+
+		ColumnarExporter& exporter;
+	};
+
+	size_t insert(size_t node, std::string_view path) {
+		while (!path.empty()) {
+			const auto dot = path.find('.');
+			const auto key = path.substr(0, dot);
+			auto& children = nodes[node].children;
+			auto it = std::find_if(children.begin(), children.end(), [&](const auto& child) { return child.first == key; });
+			if (it != children.end()) {
+				node = it->second;
+			} else {
+				children.emplace_back(std::string(key), nodes.size());
+				node = nodes.size();
+				nodes.emplace_back();
+			}
+			path = dot == std::string_view::npos ? std::string_view{} : path.substr(dot + 1);
+		}
+		return node;
+	}
+
+	// The node for key `name` of the current compound.
+	const Node* child(std::string_view name) const {
+		const auto parent = frames.back().node;
+		if (parent == nullptr) {
+			return nullptr;
+		}
+		for (const auto& [key, index] : parent->children) {
+			if (key == name) {
+				return &nodes[index];
+			}
+		}
+		return nullptr;
+	}
+
+	// The column at `node` if it takes `type` and has no value in this row yet, or -1.
+	int columnAt(const Node* node, ID type) {
+		if (node == nullptr || node->column < 0 || filled[static_cast<size_t>(node->column)]) {
+			return -1;
+		}
+		return current.columns[static_cast<size_t>(node->column)].spec.type == type ? node->column : -1;
+	}
+
+	// A number or string, either the value of a column or an element of a LIST column.
+	void value(std::string_view name, ID type, const void* data, size_t size) {
+		const auto& top = frames.back();
+		if (top.list) {
+			if (top.column >= 0) {
+				auto& column = current.columns[static_cast<size_t>(top.column)];
+				append(column.values, data, size);
+				if (type == ID::STRING) {
+					column.elementOffsets.push_back(static_cast<int32_t>(column.values.size()));
+				}
+			}
+			return;
+		}
+		const auto index = columnAt(child(name), type);
+		if (index < 0) {
+			return;
+		}
+		auto& column = current.columns[static_cast<size_t>(index)];
+		append(column.values, data, size);
+		if (type == ID::STRING) {
+			column.offsets.push_back(static_cast<int32_t>(column.values.size()));
+		}
+		setValid(column, true);
+		filled[static_cast<size_t>(index)] = true;
+	}
+
+	void endList(size_t index) {
+		auto& column = current.columns[index];
+		const auto elements = column.spec.type == ID::LIST && column.spec.element == ID::STRING ? column.elementOffsets.size() - 1 : column.values.size() / width(column.spec);
+		column.offsets.push_back(static_cast<int32_t>(elements));
+		setValid(column, true);
+		filled[index] = true;
+	}
+
+	void endRow() {
+		for (size_t i = 0; i < current.columns.size(); ++i) {
+			if (filled[i]) {
+				continue;
+			}
+			auto& column = current.columns[i];
+			if (column.offsets.empty()) {
+				column.values.resize(column.values.size() + width(column.spec));
+			} else {
+				column.offsets.push_back(column.offsets.back());
+			}
+			setValid(column, false);
+			++column.nulls;
+		}
+		++current.rows;
+	}
+
+	// Size of one number, or of one element for arrays and LISTs; 1 for strings.
+	static size_t width(const ColumnSpec& spec) {
+		switch (spec.type == ID::LIST ? spec.element : spec.type) {
+			case ID::SHORT:
+				return 2;
+			case ID::INT:
+			case ID::FLOAT:
+			case ID::INT_ARRAY:
+				return 4;
+			case ID::LONG:
+			case ID::DOUBLE:
+			case ID::LONG_ARRAY:
+				return 8;
+			default:
+				return 1;
+		}
+	}
+
+	static bool hasOffsets(const ColumnSpec& spec) {
+		return spec.type == ID::STRING || spec.type == ID::LIST || spec.type == ID::BYTE_ARRAY || spec.type == ID::INT_ARRAY || spec.type == ID::LONG_ARRAY;
+	}
+
+	static void append(std::vector<std::byte>& out, const void* data, size_t size) {
+		const auto bytes = static_cast<const std::byte*>(data);
+		out.insert(out.end(), bytes, bytes + size);
+	}
+
+	static void setValid(Column& column, bool valid) {
+		if (column.length % 8 == 0) {
+			column.validity.push_back(0);
+		}
+		column.validity.back() |= static_cast<uint8_t>(valid) << (column.length % 8);
+		++column.length;
+	}
+
+	void clear() {
+		for (auto& column : current.columns) {
+			column.length = 0;
+			column.nulls = 0;
+			column.validity.clear();
+			column.offsets.clear();
+			column.elementOffsets.clear();
+			column.values.clear();
+			if (hasOffsets(column.spec)) {
+				column.offsets.push_back(0);
+			}
+			if (column.spec.type == ID::LIST && column.spec.element == ID::STRING) {
+				column.elementOffsets.push_back(0);
+			}
+		}
+		current.rows = 0;
+	}
+
+	template <typename Stream>
+	bool exportRows(Stream& stream) {
+		marks.clear();
+		for (const auto& column : current.columns) {
+			marks.push_back(Mark{ column.length, column.nulls, column.offsets.size(), column.elementOffsets.size(), column.values.size() });
+		}
+		const auto rows = current.rows;
+		frames.clear();
+		array = -1;
+
+		Handler handler(*this);
+		if (!stream.parse(handler)) {
+			for (size_t i = 0; i < current.columns.size(); ++i) {
+				auto& column = current.columns[i];
+				const auto& mark = marks[i];
+				column.length = mark.length;
+				column.nulls = mark.nulls;
+				column.offsets.resize(mark.offsets);
+				column.elementOffsets.resize(mark.elementOffsets);
+				column.values.resize(mark.values);
+				column.validity.resize((mark.length + 7) / 8);
+				if (mark.length % 8 != 0) {
+					column.validity.back() &= static_cast<uint8_t>((1u << (mark.length % 8)) - 1);
+				}
+			}
+			current.rows = rows;
+			return false;
+		}
+		if (current.rows >= batchRows) {
+			flush();
+		}
+		return true;
+	}
+
+	std::vector<Node> nodes{ Node{} };
+	size_t batchRows;
+	Sink sink;
+	ColumnBatch current{};
+	std::vector<Frame> frames{};
+	std::vector<bool> filled{};
+	std::vector<Mark> marks{};
+	int array = -1;
+	SpanSource input{ {} };
+	NBTStreamReader<SpanSource> reader{ input, NBTStreamReader<SpanSource>::MIN_BUFFER };
+};
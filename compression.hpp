@@ -0,0 +1,392 @@
+#pragma once
+
+#include "nbt.hpp"
+
+// Deflate streams go through zlib's API, so a zlib-ng build in compatibility mode can be
+// dropped in without changes. Define NBT_USE_LIBDEFLATE to decode whole gzip/zlib buffers
+// with libdeflate instead. LZ4 support is enabled when the lz4 headers are available.
+#include <zlib.h>
+
+#if __has_include(<lz4.h>)
+#include <lz4.h>
+#define NBT_HAS_LZ4 1
+#endif
+
+#if __has_include(<lz4frame.h>)
+#include <lz4frame.h>
+#define NBT_HAS_LZ4F 1
+#endif
+
+#if defined(NBT_USE_LIBDEFLATE)
+#include <libdeflate.h>
+#endif
+
+#include <climits>
+#include <memory>
+
+enum class Compression {
+	NONE,
+	GZIP,
+	ZLIB,
+	LZ4_FRAME,
+	LZ4_BLOCK,
+};
+
+inline Compression detectCompression(std::span<const std::byte> data) {
+	const auto byte = [&](size_t i) {
+		return static_cast<uint8_t>(data[i]);
+	};
+	if (data.size() >= 2 && byte(0) == 0x1f && byte(1) == 0x8b) {
+		return Compression::GZIP;
+	}
+	if (data.size() >= 2 && (byte(0) & 0x0f) == 8 && ((byte(0) << 8) | byte(1)) % 31 == 0) {
+		return Compression::ZLIB;
+	}
+	if (data.size() >= 4 && byte(0) == 0x04 && byte(1) == 0x22 && byte(2) == 0x4d && byte(3) == 0x18) {
+		return Compression::LZ4_FRAME;
+	}
+	if (data.size() >= 8 && std::memcmp(data.data(), "LZ4Block", 8) == 0) {
+		return Compression::LZ4_BLOCK;
+	}
+	return Compression::NONE;
+}
+
+struct ZlibInflater {
+	explicit ZlibInflater(Compression format) {
+		ok = inflateInit2(&stream, format == Compression::GZIP ? 16 + MAX_WBITS : MAX_WBITS) == Z_OK;
+	}
+
+	ZlibInflater(const ZlibInflater&) = delete;
+	ZlibInflater& operator=(const ZlibInflater&) = delete;
+
+	~ZlibInflater() {
+		if (ok) {
+			inflateEnd(&stream);
+		}
+	}
+
+	std::optional<size_t> inflate(std::span<const std::byte>& in, std::span<std::byte> out) {
+		if (!ok) {
+			return std::nullopt;
+		}
+		if (done || out.empty()) {
+			return 0;
+		}
+		stream.next_out = reinterpret_cast<Bytef*>(out.data());
+		stream.avail_out = static_cast<uInt>(std::min<size_t>(out.size(), UINT_MAX));
+
+		size_t produced = 0;
+		while (produced == 0 && !done) {
+			stream.next_in = reinterpret_cast<Bytef*>(const_cast<std::byte*>(in.data()));
+			stream.avail_in = static_cast<uInt>(std::min<size_t>(in.size(), UINT_MAX));
+
+			const auto status = ::inflate(&stream, Z_NO_FLUSH);
+			in = in.subspan(static_cast<size_t>(stream.next_in - reinterpret_cast<const Bytef*>(in.data())));
+			produced = static_cast<size_t>(stream.next_out - reinterpret_cast<Bytef*>(out.data()));
+
+			if (status == Z_STREAM_END) {
+				done = true;
+			} else if (status != Z_OK || (produced == 0 && in.empty())) {
+				return std::nullopt;
+			}
+		}
+		return produced;
+	}
+
+	bool finished() const {
+		return done;
+	}
+
+private:
+	z_stream stream{};
+	bool ok = false;
+	bool done = false;
+};
+
+#if NBT_HAS_LZ4
+// The block stream written by lz4-java's LZ4BlockOutputStream, which Minecraft uses for
+// region chunks stored with compression type 4. Block checksums are not verified.
+struct Lz4BlockInflater {
+	explicit Lz4BlockInflater(Compression) {}
+
+	std::optional<size_t> inflate(std::span<const std::byte>& in, std::span<std::byte> out) {
+		size_t produced = 0;
+		while (produced < out.size() && !done) {
+			if (offset == block.size() && !nextBlock(in)) {
+				return std::nullopt;
+			}
+			const auto count = std::min(out.size() - produced, block.size() - offset);
+			std::memcpy(out.data() + produced, block.data() + offset, count);
+			offset += count;
+			produced += count;
+		}
+		return produced;
+	}
+
+	bool finished() const {
+		return done && offset == block.size();
+	}
+
+private:
+	bool nextBlock(std::span<const std::byte>& in) {
+		constexpr size_t header = 21;
+		if (in.size() < header || std::memcmp(in.data(), "LZ4Block", 8) != 0) {
+			return false;
+		}
+		const auto method = static_cast<uint8_t>(in[8]) & 0xf0;
+		// The low bits give the stream's block size as 1 << (10 + level), at most 32 MiB; a
+		// block claiming to be larger is corrupt, and is refused before it is allocated.
+		const auto maxBlock = size_t{ 1 } << (10 + (static_cast<uint8_t>(in[8]) & 0x0f));
+		const auto compressed = loadEndian<std::endian::little, int32_t>(in.data() + 9);
+		const auto decompressed = loadEndian<std::endian::little, int32_t>(in.data() + 13);
+		if (compressed < 0 || decompressed < 0 || static_cast<size_t>(compressed) > in.size() - header || static_cast<size_t>(decompressed) > maxBlock) {
+			return false;
+		}
+		const auto payload = in.subspan(header, static_cast<size_t>(compressed));
+		in = in.subspan(header + payload.size());
+
+		block.resize(static_cast<size_t>(decompressed));
+		offset = 0;
+		if (decompressed == 0) {
+			done = true;
+			return true;
+		}
+		if (method == 0x10) {
+			if (compressed != decompressed) {
+				return false;
+			}
+			std::memcpy(block.data(), payload.data(), payload.size());
+			return true;
+		}
+		if (method == 0x20) {
+			const auto size = LZ4_decompress_safe(reinterpret_cast<const char*>(payload.data()), reinterpret_cast<char*>(block.data()), compressed, decompressed);
+			return size == decompressed;
+		}
+		return false;
+	}
+
+	std::vector<std::byte> block{};
+	size_t offset = 0;
+	bool done = false;
+};
+#endif
+
+#if NBT_HAS_LZ4F
+struct Lz4FrameInflater {
+	explicit Lz4FrameInflater(Compression) {
+		ok = !LZ4F_isError(LZ4F_createDecompressionContext(&context, LZ4F_VERSION));
+	}
+
+	Lz4FrameInflater(const Lz4FrameInflater&) = delete;
+	Lz4FrameInflater& operator=(const Lz4FrameInflater&) = delete;
+
+	~Lz4FrameInflater() {
+		if (ok) {
+			LZ4F_freeDecompressionContext(context);
+		}
+	}
+
+	std::optional<size_t> inflate(std::span<const std::byte>& in, std::span<std::byte> out) {
+		if (!ok) {
+			return std::nullopt;
+		}
+		if (done || out.empty()) {
+			return 0;
+		}
+		size_t produced = 0;
+		while (produced == 0 && !done) {
+			size_t written = out.size();
+			size_t consumed = in.size();
+			const auto hint = LZ4F_decompress(context, out.data(), &written, in.data(), &consumed, nullptr);
+			if (LZ4F_isError(hint)) {
+				return std::nullopt;
+			}
+			in = in.subspan(consumed);
+			produced = written;
+			done = hint == 0;
+			if (!done && produced == 0 && in.empty()) {
+				return std::nullopt;
+			}
+		}
+		return produced;
+	}
+
+	bool finished() const {
+		return done;
+	}
+
+private:
+	LZ4F_dctx* context = nullptr;
+	bool ok = false;
+	bool done = false;
+};
+#endif
+
+// Pull-based decompressor over a complete compressed buffer: every read() produces at most
+// `out.size()` bytes, so callers can consume arbitrarily large documents in bounded memory.
+struct InflateStream {
+	explicit InflateStream(std::span<const std::byte> compressed) : InflateStream(compressed, detectCompression(compressed)) {}
+
+	InflateStream(std::span<const std::byte> compressed, Compression format) : input(compressed), compression(format) {
+		switch (format) {
+			case Compression::GZIP:
+			case Compression::ZLIB:
+				inflater = std::make_unique<Inflater<ZlibInflater>>(format);
+				break;
+#if NBT_HAS_LZ4F
+			case Compression::LZ4_FRAME:
+				inflater = std::make_unique<Inflater<Lz4FrameInflater>>(format);
+				break;
+#endif
+#if NBT_HAS_LZ4
+			case Compression::LZ4_BLOCK:
+				inflater = std::make_unique<Inflater<Lz4BlockInflater>>(format);
+				break;
+#endif
+			case Compression::NONE:
+				break;
+			default:
+				failed = true;
+				break;
+		}
+	}
+
+	Compression format() const {
+		return compression;
+	}
+
+	bool supported() const {
+		return !failed;
+	}
+
+	// Returns the number of bytes written to `out` (0 only once the stream is exhausted), or
+	// std::nullopt if the input is corrupt, truncated or uses an unsupported format.
+	std::optional<size_t> read(std::span<std::byte> out) {
+		if (failed) {
+			return std::nullopt;
+		}
+		if (inflater == nullptr) {
+			const auto count = std::min(out.size(), input.size());
+			std::memcpy(out.data(), input.data(), count);
+			input = input.subspan(count);
+			return count;
+		}
+		auto produced = inflater->inflate(input, out);
+		if (!produced.has_value()) {
+			failed = true;
+		}
+		return produced;
+	}
+
+	bool finished() const {
+		return inflater == nullptr ? input.empty() : inflater->finished();
+	}
+
+private:
+	struct Base {
+		virtual ~Base() = default;
+		virtual std::optional<size_t> inflate(std::span<const std::byte>& in, std::span<std::byte> out) = 0;
+		virtual bool finished() const = 0;
+	};
+
+	template <typename T>
+	struct Inflater final : Base {
+		explicit Inflater(Compression format) : impl(format) {}
+
+		std::optional<size_t> inflate(std::span<const std::byte>& in, std::span<std::byte> out) override {
+			return impl.inflate(in, out);
+		}
+
+		bool finished() const override {
+			return impl.finished();
+		}
+
+		T impl;
+	};
+
+	std::span<const std::byte> input{};
+	Compression compression = Compression::NONE;
+	std::unique_ptr<Base> inflater{};
+	bool failed = false;
+};
+
+// Default bound on what decompress() may produce, far above any real chunk or level.dat, so
+// that a small compressed bomb cannot make it allocate without limit.
+inline constexpr size_t MAX_DECOMPRESSED_SIZE = 64 * 1024 * 1024;
+
+// Capacity decompressionBuffer() keeps between calls; a larger buffer is released at the
+// start of the next decompress() on its thread instead of being held for good.
+inline constexpr size_t MAX_RETAINED_DECOMPRESSION_BUFFER = 4 * 1024 * 1024;
+
+// Scratch space reused by decompress() on each thread.
+inline std::vector<std::byte>& decompressionBuffer() {
+	thread_local std::vector<std::byte> buffer{};
+	return buffer;
+}
+
+// Decompresses `compressed` into this thread's decompressionBuffer(), `chunk` bytes at a
+// time, and fails if the output would exceed `maxSize` bytes. The returned span stays valid
+// until the next decompress() call on the same thread.
+inline std::optional<std::span<const std::byte>> decompress(std::span<const std::byte> compressed, size_t chunk = 64 * 1024, size_t maxSize = MAX_DECOMPRESSED_SIZE) {
+	const auto format = detectCompression(compressed);
+	if (format == Compression::NONE) {
+		return compressed;
+	}
+
+	auto& buffer = decompressionBuffer();
+	if (buffer.capacity() > MAX_RETAINED_DECOMPRESSION_BUFFER) {
+		std::vector<std::byte>().swap(buffer);
+	}
+	buffer.clear();
+
+#if defined(NBT_USE_LIBDEFLATE)
+	if (format == Compression::GZIP || format == Compression::ZLIB) {
+		thread_local std::unique_ptr<libdeflate_decompressor, decltype(&libdeflate_free_decompressor)> decompressor{
+			libdeflate_alloc_decompressor(), &libdeflate_free_decompressor
+		};
+		buffer.resize(std::min(std::max(buffer.capacity(), compressed.size() * 4), maxSize));
+		while (true) {
+			size_t produced = 0;
+			const auto result = format == Compression::GZIP
+				? libdeflate_gzip_decompress(decompressor.get(), compressed.data(), compressed.size(), buffer.data(), buffer.size(), &produced)
+				: libdeflate_zlib_decompress(decompressor.get(), compressed.data(), compressed.size(), buffer.data(), buffer.size(), &produced);
+			if (result == LIBDEFLATE_SUCCESS) {
+				buffer.resize(produced);
+				return std::span<const std::byte>(buffer);
+			}
+			if (result != LIBDEFLATE_INSUFFICIENT_SPACE || buffer.size() >= maxSize) {
+				return std::nullopt;
+			}
+			buffer.resize(std::min(std::max<size_t>(buffer.size() * 2, 1), maxSize));
+		}
+	}
+#endif
+
+	InflateStream stream(compressed, format);
+	size_t size = 0;
+	chunk = std::max<size_t>(chunk, 1);
+	while (!stream.finished()) {
+		// One byte past the limit, so that output of exactly `maxSize` bytes still fits.
+		const auto count = maxSize - size < chunk ? maxSize - size + 1 : chunk;
+		if (buffer.size() < size + count) {
+			buffer.resize(size + count);
+		}
+		auto produced = stream.read(std::span(buffer).subspan(size, count));
+		if (!produced.has_value()) {
+			return std::nullopt;
+		}
+		size += *produced;
+		if (size > maxSize) {
+			return std::nullopt;
+		}
+	}
+	buffer.resize(size);
+	return std::span<const std::byte>(buffer);
+}
+
+inline std::optional<CompoundTag> readCompressed(std::span<const std::byte> compressed, std::pmr::memory_resource* resource = std::pmr::get_default_resource(), NameInterner* names = nullptr, size_t maxSize = MAX_DECOMPRESSED_SIZE) {
+	if (auto data = decompress(compressed, 64 * 1024, maxSize)) {
+		return NBTFile(*data, resource, names).read();
+	}
+	return std::nullopt;
+}
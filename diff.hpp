@@ -0,0 +1,638 @@
+#pragma once
+
+#include "nbt.hpp"
+
+#include <numeric>
+
+// Binary patches between two uncompressed Java documents, computed and applied on the
+// encoded bytes. Values whose bytes are equal are passed over with one memcmp; a changed
+// compound is patched key by key, a changed array by the element ranges that differ, and a
+// changed list of the same type and length by the elements that differ. Anything else,
+// or anything whose patch would be no smaller, is sent as the new value. Payloads in the
+// patch are copied from the target without being decoded or re-encoded.
+//
+// Compound patches list the target's entries in the target's order, unchanged runs as
+// references to the base, so apply(base, diff(base, target)) is target byte for byte
+// whatever order its keys were written in, and a replica can take the next patch.
+//
+// A patch starts with the size and hash of the document it was made against, and apply()
+// refuses any other base.
+struct NBTDiff {
+	using ID = TagID;
+
+	// Appends a patch from `base` to `target` to `patch`; fails if either is malformed.
+	static bool diff(std::span<const std::byte> base, std::span<const std::byte> target, std::vector<std::byte>& patch) {
+		const auto from = root(base);
+		const auto to = root(target);
+		if (!from.has_value() || !to.has_value()) {
+			return false;
+		}
+		patch.push_back(static_cast<std::byte>(VERSION));
+		writeVarUInt(patch, base.size());
+		appendLittle(patch, hash(base));
+		writeVarUInt(patch, to->name.size());
+		append(patch, to->name.data(), to->name.size());
+		return diffCompound(from->payload, to->payload, patch);
+	}
+
+	static bool diff(const CompoundTag& base, const CompoundTag& target, std::vector<std::byte>& patch) {
+		std::vector<std::byte> from{};
+		std::vector<std::byte> to{};
+		if (!NBTWriter(from).write("", base) || !NBTWriter(to).write("", target)) {
+			return false;
+		}
+		return diff(from, to, patch);
+	}
+
+	// Appends `base` with `patch` applied to `out`. Fails if the patch is malformed or was not
+	// made against `base`; `out` is then left with a partial document.
+	static bool apply(std::span<const std::byte> base, std::span<const std::byte> patch, std::vector<std::byte>& out) {
+		Reader reader{ patch };
+		const auto version = reader.byte();
+		const auto size = reader.varint();
+		const auto checksum = reader.bytes(sizeof(uint64_t));
+		if (version != VERSION || size != base.size() || !checksum.has_value() || loadEndian<std::endian::little, uint64_t>(checksum->data()) != hash(base)) {
+			return false;
+		}
+		const auto name = reader.name();
+		const auto from = root(base);
+		if (!name.has_value() || name->size() > UINT16_MAX || !from.has_value()) {
+			return false;
+		}
+		out.push_back(static_cast<std::byte>(ID::COMPOUND));
+		writeName(out, *name);
+		return applyCompound(from->payload, reader, out, 0) && reader.done();
+	}
+
+private:
+	static constexpr uint8_t VERSION = 2;
+
+	enum class Op : uint8_t {
+		END,
+		// Followed by the name, type and payload of a new entry; in a list patch, by the
+		// payload of the new element.
+		SET,
+		// Followed by the index and count of a run of base entries copied as they are.
+		KEEP,
+		// In a compound patch, followed by the index of a base entry; then the 32-bit
+		// little-endian size of a patch for its value.
+		PATCH,
+	};
+
+	struct Root {
+		std::string_view name;
+		std::span<const std::byte> payload;
+	};
+
+	struct Entry {
+		std::string_view name;
+		ID id;
+		// The whole entry, from its type to the end of its payload.
+		std::span<const std::byte> bytes;
+		std::span<const std::byte> payload;
+	};
+
+	// Patch input; every read fails once the patch runs out.
+	struct Reader {
+		std::span<const std::byte> data;
+		size_t pos = 0;
+
+		std::optional<uint8_t> byte() {
+			if (pos >= data.size()) {
+				return std::nullopt;
+			}
+			return static_cast<uint8_t>(data[pos++]);
+		}
+
+		std::optional<uint64_t> varint() {
+			uint64_t value = 0;
+			for (unsigned shift = 0; shift < 64; shift += 7) {
+				const auto b = byte();
+				if (!b.has_value()) {
+					return std::nullopt;
+				}
+				value |= static_cast<uint64_t>(*b & 0x7f) << shift;
+				if ((*b & 0x80) == 0) {
+					return value;
+				}
+			}
+			return std::nullopt;
+		}
+
+		std::optional<std::span<const std::byte>> bytes(uint64_t size) {
+			if (size > data.size() - pos) {
+				return std::nullopt;
+			}
+			const auto result = data.subspan(pos, static_cast<size_t>(size));
+			pos += result.size();
+			return result;
+		}
+
+		std::optional<std::string_view> name() {
+			const auto size = varint();
+			if (!size.has_value()) {
+				return std::nullopt;
+			}
+			const auto str = bytes(*size);
+			if (!str.has_value()) {
+				return std::nullopt;
+			}
+			return std::string_view(reinterpret_cast<const char*>(str->data()), str->size());
+		}
+
+		// A value of type `id`, measured by skipping it.
+		std::optional<std::span<const std::byte>> payload(ID id) {
+			NBTFile file(data.subspan(pos));
+			if (!file.skipTag(id)) {
+				return std::nullopt;
+			}
+			return bytes(file.position());
+		}
+
+		std::optional<std::span<const std::byte>> body() {
+			const auto size = bytes(sizeof(uint32_t));
+			if (!size.has_value()) {
+				return std::nullopt;
+			}
+			return bytes(loadEndian<std::endian::little, uint32_t>(size->data()));
+		}
+
+		bool done() const {
+			return pos == data.size();
+		}
+	};
+
+	static uint64_t hash(std::span<const std::byte> document) {
+		return nameHash(std::string_view(reinterpret_cast<const char*>(document.data()), document.size()));
+	}
+
+	static std::optional<Root> root(std::span<const std::byte> document) {
+		NBTFile file(document);
+		if (file.readID().value_or(ID::END) != ID::COMPOUND) {
+			return std::nullopt;
+		}
+		const auto name = file.readStringView();
+		const auto start = file.position();
+		if (!name.has_value() || !file.skipTag(ID::COMPOUND)) {
+			return std::nullopt;
+		}
+		return Root{ *name, document.subspan(start, file.position() - start) };
+	}
+
+	// The entries of a compound payload, in the order they are stored.
+	static std::optional<std::vector<Entry>> entries(std::span<const std::byte> payload) {
+		std::vector<Entry> result{};
+		NBTFile file(payload);
+		while (true) {
+			const auto start = file.position();
+			const auto id = file.readID();
+			if (!id.has_value()) {
+				return std::nullopt;
+			}
+			if (*id == ID::END) {
+				break;
+			}
+			const auto name = file.readStringView();
+			const auto begin = file.position();
+			if (!name.has_value() || !file.skipTag(*id)) {
+				return std::nullopt;
+			}
+			result.push_back(Entry{ *name, *id, payload.subspan(start, file.position() - start), payload.subspan(begin, file.position() - begin) });
+		}
+		return result;
+	}
+
+	static bool equal(std::span<const std::byte> a, std::span<const std::byte> b) {
+		return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()) == 0;
+	}
+
+	static void append(std::vector<std::byte>& out, const void* data, size_t size) {
+		const auto bytes = static_cast<const std::byte*>(data);
+		out.insert(out.end(), bytes, bytes + size);
+	}
+
+	static void append(std::vector<std::byte>& out, std::span<const std::byte> bytes) {
+		out.insert(out.end(), bytes.begin(), bytes.end());
+	}
+
+	template <typename T>
+	static void appendLittle(std::vector<std::byte>& out, T value) {
+		std::array<std::byte, sizeof(T)> bytes{};
+		storeEndian<std::endian::little, T>(bytes.data(), value);
+		append(out, std::span<const std::byte>(bytes));
+	}
+
+	static void writeVarUInt(std::vector<std::byte>& out, uint64_t value) {
+		while (value >= 0x80) {
+			out.push_back(static_cast<std::byte>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<std::byte>(value));
+	}
+
+	// A name as NBT stores it.
+	static void writeName(std::vector<std::byte>& out, std::string_view name) {
+		std::array<std::byte, 2> length{};
+		storeBigEndian<uint16_t>(length.data(), static_cast<uint16_t>(name.size()));
+		append(out, std::span<const std::byte>(length));
+		append(out, name.data(), name.size());
+	}
+
+	// Writes `key` followed by a change from `from` to `to`: a PATCH if one exists and is
+	// smaller, otherwise a SET, whose type is only written if `typed`.
+	template <typename Key>
+	static bool change(ID id, std::span<const std::byte> from, std::span<const std::byte> to, bool typed, std::vector<std::byte>& out, Key&& key) {
+		const auto mark = out.size();
+		key(Op::PATCH);
+		const auto length = out.size();
+		appendLittle(out, uint32_t{ 0 });
+		const auto body = out.size();
+		const auto patched = patchValue(id, from, to, out);
+		if (!patched.has_value()) {
+			return false;
+		}
+		if (*patched && out.size() - length < to.size() + (typed ? 1 : 0)) {
+			storeEndian<std::endian::little, uint32_t>(out.data() + length, static_cast<uint32_t>(out.size() - body));
+			return true;
+		}
+		out.resize(mark);
+		key(Op::SET);
+		if (typed) {
+			out.push_back(static_cast<std::byte>(id));
+		}
+		append(out, to);
+		return true;
+	}
+
+	// Writes a patch body for a value of type `id`; false if the type has none, empty if a
+	// value is malformed.
+	static std::optional<bool> patchValue(ID id, std::span<const std::byte> from, std::span<const std::byte> to, std::vector<std::byte>& out) {
+		switch (id) {
+			case ID::COMPOUND:
+				if (!diffCompound(from, to, out)) {
+					return std::nullopt;
+				}
+				return true;
+			case ID::BYTE_ARRAY:
+				diffArray(from, to, 1, out);
+				return true;
+			case ID::INT_ARRAY:
+				diffArray(from, to, 4, out);
+				return true;
+			case ID::LONG_ARRAY:
+				diffArray(from, to, 8, out);
+				return true;
+			case ID::LIST:
+				return diffList(from, to, out);
+			default:
+				return false;
+		}
+	}
+
+	// Compound patch: one op per run of target entries, in the target's order, then END.
+	static bool diffCompound(std::span<const std::byte> from, std::span<const std::byte> to, std::vector<std::byte>& out) {
+		const auto before = entries(from);
+		const auto after = entries(to);
+		if (!before.has_value() || !after.has_value()) {
+			return false;
+		}
+		// Base entries by name; a duplicate key pairs up with its entries in order.
+		std::vector<size_t> byName(before->size());
+		std::iota(byName.begin(), byName.end(), size_t{ 0 });
+		std::stable_sort(byName.begin(), byName.end(), [&](size_t a, size_t b) {
+			return (*before)[a].name < (*before)[b].name;
+		});
+		std::vector<bool> matched(before->size());
+		const auto match = [&](std::string_view key) -> std::optional<size_t> {
+			auto it = std::lower_bound(byName.begin(), byName.end(), key, [&](size_t i, std::string_view name) {
+				return (*before)[i].name < name;
+			});
+			for (; it != byName.end() && (*before)[*it].name == key; ++it) {
+				if (!matched[*it]) {
+					matched[*it] = true;
+					return *it;
+				}
+			}
+			return std::nullopt;
+		};
+
+		// A pending run of base entries [keep, keep + kept).
+		size_t keep = 0;
+		size_t kept = 0;
+		const auto flush = [&] {
+			if (kept != 0) {
+				out.push_back(static_cast<std::byte>(Op::KEEP));
+				writeVarUInt(out, keep);
+				writeVarUInt(out, kept);
+				kept = 0;
+			}
+		};
+		const auto set = [&](const Entry& entry) {
+			out.push_back(static_cast<std::byte>(Op::SET));
+			writeVarUInt(out, entry.name.size());
+			append(out, entry.name.data(), entry.name.size());
+		};
+
+		for (const auto& entry : *after) {
+			const auto index = match(entry.name);
+			if (index.has_value() && equal((*before)[*index].bytes, entry.bytes)) {
+				if (kept != 0 && keep + kept == *index) {
+					++kept;
+				} else {
+					flush();
+					keep = *index;
+					kept = 1;
+				}
+				continue;
+			}
+			flush();
+			if (index.has_value() && (*before)[*index].id == entry.id) {
+				const auto key = [&](Op op) {
+					if (op == Op::PATCH) {
+						out.push_back(static_cast<std::byte>(op));
+						writeVarUInt(out, *index);
+					} else {
+						set(entry);
+					}
+				};
+				if (!change(entry.id, (*before)[*index].payload, entry.payload, true, out, key)) {
+					return false;
+				}
+				continue;
+			}
+			set(entry);
+			out.push_back(static_cast<std::byte>(entry.id));
+			append(out, entry.payload);
+		}
+		flush();
+		out.push_back(static_cast<std::byte>(Op::END));
+		return true;
+	}
+
+	// Array patch: the new length, then ranges of replaced elements as start, count and the
+	// raw elements. Ranges closer together than a range header are merged.
+	static void diffArray(std::span<const std::byte> from, std::span<const std::byte> to, size_t size, std::vector<std::byte>& out) {
+		constexpr size_t GAP = 4;
+		const size_t n = loadBigEndian<uint32_t>(to.data());
+		const size_t common = std::min<size_t>(loadBigEndian<uint32_t>(from.data()), n);
+		const auto a = from.data() + 4;
+		const auto b = to.data() + 4;
+		const auto differs = [&](size_t i) {
+			return i >= common || std::memcmp(a + i * size, b + i * size, size) != 0;
+		};
+
+		std::vector<std::pair<size_t, size_t>> ranges{};
+		for (size_t i = 0; i < n;) {
+			// Skips equal stretches 8 elements at a time.
+			if (i + 8 <= common && std::memcmp(a + i * size, b + i * size, 8 * size) == 0) {
+				i += 8;
+				continue;
+			}
+			if (!differs(i)) {
+				++i;
+				continue;
+			}
+			const auto start = i;
+			auto end = i + 1;
+			for (size_t gap = 0; end + gap < n && gap * size <= GAP;) {
+				if (differs(end + gap)) {
+					end += gap + 1;
+					gap = 0;
+				} else {
+					++gap;
+				}
+			}
+			ranges.emplace_back(start, end - start);
+			i = end;
+		}
+
+		writeVarUInt(out, n);
+		writeVarUInt(out, ranges.size());
+		for (const auto& [start, count] : ranges) {
+			writeVarUInt(out, start);
+			writeVarUInt(out, count);
+			append(out, b + start * size, count * size);
+		}
+	}
+
+	// List patch: the count of changed elements, then each as its index and a change. Only
+	// lists of the same type and length whose elements can be patched qualify.
+	static std::optional<bool> diffList(std::span<const std::byte> from, std::span<const std::byte> to, std::vector<std::byte>& out) {
+		const auto element = static_cast<ID>(from[0]);
+		const size_t n = loadBigEndian<uint32_t>(from.data() + 1);
+		if (static_cast<ID>(to[0]) != element || loadBigEndian<uint32_t>(to.data() + 1) != n) {
+			return false;
+		}
+		if (element != ID::COMPOUND && element != ID::LIST && element != ID::BYTE_ARRAY && element != ID::INT_ARRAY && element != ID::LONG_ARRAY) {
+			return false;
+		}
+
+		const auto count = out.size();
+		appendLittle(out, uint32_t{ 0 });
+		uint32_t changed = 0;
+		NBTFile a(from.subspan(5));
+		NBTFile b(to.subspan(5));
+		for (size_t i = 0; i < n; ++i) {
+			const auto x = a.position();
+			const auto y = b.position();
+			if (!a.skipTag(element) || !b.skipTag(element)) {
+				return std::nullopt;
+			}
+			const auto previous = from.subspan(5 + x, a.position() - x);
+			const auto current = to.subspan(5 + y, b.position() - y);
+			if (equal(previous, current)) {
+				continue;
+			}
+			++changed;
+			const auto index = [&out, i](Op op) {
+				writeVarUInt(out, i);
+				out.push_back(static_cast<std::byte>(op));
+			};
+			if (!change(element, previous, current, false, out, index)) {
+				return std::nullopt;
+			}
+		}
+		storeEndian<std::endian::little, uint32_t>(out.data() + count, changed);
+		return true;
+	}
+
+	// Writes the compound `payload` with `patch` applied, entry by entry in the order the
+	// patch lists them.
+	static bool applyCompound(std::span<const std::byte> payload, Reader& patch, std::vector<std::byte>& out, size_t depth) {
+		if (depth >= NBTFile::MAX_DEPTH) {
+			return false;
+		}
+		const auto before = entries(payload);
+		if (!before.has_value()) {
+			return false;
+		}
+		while (true) {
+			const auto op = patch.byte();
+			if (!op.has_value()) {
+				return false;
+			}
+			switch (static_cast<Op>(*op)) {
+				case Op::END:
+					out.push_back(static_cast<std::byte>(ID::END));
+					return true;
+				case Op::SET: {
+					const auto name = patch.name();
+					const auto id = patch.byte();
+					if (!name.has_value() || name->size() > UINT16_MAX || !id.has_value() || *id == 0 || *id > static_cast<uint8_t>(ID::LONG_ARRAY)) {
+						return false;
+					}
+					const auto value = patch.payload(static_cast<ID>(*id));
+					if (!value.has_value()) {
+						return false;
+					}
+					out.push_back(static_cast<std::byte>(*id));
+					writeName(out, *name);
+					append(out, *value);
+					break;
+				}
+				case Op::KEEP: {
+					const auto first = patch.varint();
+					const auto count = patch.varint();
+					if (!first.has_value() || !count.has_value() || *first > before->size() || *count > before->size() - *first) {
+						return false;
+					}
+					for (size_t i = *first; i < *first + *count; ++i) {
+						append(out, (*before)[i].bytes);
+					}
+					break;
+				}
+				case Op::PATCH: {
+					const auto index = patch.varint();
+					if (!index.has_value() || *index >= before->size()) {
+						return false;
+					}
+					const auto body = patch.body();
+					const auto& entry = (*before)[*index];
+					if (!body.has_value()) {
+						return false;
+					}
+					out.push_back(static_cast<std::byte>(entry.id));
+					writeName(out, entry.name);
+					if (!applyValue(entry.id, entry.payload, *body, out, depth + 1)) {
+						return false;
+					}
+					break;
+				}
+				default:
+					return false;
+			}
+		}
+	}
+
+	// Writes the value of type `id` in `payload` with the patch `body` applied, which must be
+	// used up exactly.
+	static bool applyValue(ID id, std::span<const std::byte> payload, std::span<const std::byte> body, std::vector<std::byte>& out, size_t depth) {
+		Reader patch{ body };
+		bool applied = false;
+		switch (id) {
+			case ID::COMPOUND:
+				applied = applyCompound(payload, patch, out, depth);
+				break;
+			case ID::BYTE_ARRAY:
+				applied = applyArray(payload, 1, patch, out);
+				break;
+			case ID::INT_ARRAY:
+				applied = applyArray(payload, 4, patch, out);
+				break;
+			case ID::LONG_ARRAY:
+				applied = applyArray(payload, 8, patch, out);
+				break;
+			case ID::LIST:
+				applied = applyList(payload, patch, out, depth);
+				break;
+			default:
+				break;
+		}
+		return applied && patch.done();
+	}
+
+	// `payload` is a whole, already measured array.
+	static bool applyArray(std::span<const std::byte> payload, size_t size, Reader& patch, std::vector<std::byte>& out) {
+		const auto n = patch.varint();
+		const auto ranges = patch.varint();
+		if (!n.has_value() || !ranges.has_value() || *n > INT32_MAX) {
+			return false;
+		}
+		const size_t old = loadBigEndian<uint32_t>(payload.data());
+		// Elements past the old length all come from the patch, which bounds the allocation.
+		if (*n > old && (*n - old) * size > patch.data.size() - patch.pos) {
+			return false;
+		}
+		const auto start = out.size();
+		out.resize(start + 4 + *n * size);
+		const auto dst = out.data() + start;
+		storeBigEndian<uint32_t>(dst, static_cast<uint32_t>(*n));
+		std::memcpy(dst + 4, payload.data() + 4, std::min<size_t>(old, *n) * size);
+		for (uint64_t i = 0, end = 0; i < *ranges; ++i) {
+			const auto first = patch.varint();
+			const auto length = patch.varint();
+			if (!first.has_value() || !length.has_value() || *first < end || *first > *n || *length > *n - *first) {
+				return false;
+			}
+			const auto elements = patch.bytes(*length * size);
+			if (!elements.has_value()) {
+				return false;
+			}
+			std::memcpy(dst + 4 + *first * size, elements->data(), elements->size());
+			end = *first + *length;
+		}
+		return true;
+	}
+
+	// `payload` is a whole, already measured list.
+	static bool applyList(std::span<const std::byte> payload, Reader& patch, std::vector<std::byte>& out, size_t depth) {
+		const auto changes = patch.bytes(sizeof(uint32_t));
+		if (!changes.has_value()) {
+			return false;
+		}
+		const auto element = static_cast<ID>(payload[0]);
+		const size_t n = loadBigEndian<uint32_t>(payload.data() + 1);
+		append(out, payload.first(5));
+		const auto elements = payload.subspan(5);
+		NBTFile file(elements);
+		// Copies the elements before `index` as they are.
+		const auto copy = [&](uint64_t& next, uint64_t index) {
+			const auto start = file.position();
+			for (; next < index; ++next) {
+				if (!file.skipTag(element)) {
+					return false;
+				}
+			}
+			append(out, elements.subspan(start, file.position() - start));
+			return true;
+		};
+		uint64_t next = 0;
+		for (uint32_t remaining = loadEndian<std::endian::little, uint32_t>(changes->data()); remaining != 0; --remaining) {
+			const auto index = patch.varint();
+			const auto op = patch.byte();
+			if (!index.has_value() || !op.has_value() || *index < next || *index >= n || !copy(next, *index)) {
+				return false;
+			}
+			const auto start = file.position();
+			if (!file.skipTag(element)) {
+				return false;
+			}
+			++next;
+			if (static_cast<Op>(*op) == Op::SET) {
+				const auto value = patch.payload(element);
+				if (!value.has_value()) {
+					return false;
+				}
+				append(out, *value);
+			} else if (static_cast<Op>(*op) == Op::PATCH) {
+				const auto body = patch.body();
+				if (!body.has_value() || !applyValue(element, elements.subspan(start, file.position() - start), *body, out, depth + 1)) {
+					return false;
+				}
+			} else {
+				return false;
+			}
+		}
+		return copy(next, n);
+	}
+};
@@ -0,0 +1,224 @@
+#pragma once
+
+#include "nbt.hpp"
+
+// Changes recorded against an encoded document and applied while writing it back out.
+// Paths are dot-separated compound keys, such as "Level.LastUpdate". write() only walks the
+// compounds on the way to an edit: every other entry is passed over with skipTag() and
+// copied from the source in as few runs as possible, and only the edited values are
+// encoded. A chunk with one changed field is written as two memcpys and one small tag.
+//
+// The source has to outlive the editor.
+struct NBTEditor {
+	using ID = NBTFile::ID;
+
+	explicit NBTEditor(std::span<const std::byte> source) : source(source) {}
+
+	// Replaces or adds the value at `path`, creating missing compounds on the way. Fails if
+	// the path goes through a value set earlier that is not a compound, or if `value` is an
+	// EndTag, which cannot be stored in a compound.
+	bool set(std::string_view path, Tag value) {
+		if (std::holds_alternative<EndTag>(value)) {
+			return false;
+		}
+		Node* node = &root;
+		while (true) {
+			if (node->value.has_value()) {
+				return assign(*node->value, path, std::move(value));
+			}
+			const auto dot = path.find('.');
+			auto& child = node->child(path.substr(0, dot));
+			if (dot == std::string_view::npos) {
+				child = Node{ std::move(child.name), std::move(value), false, {} };
+				return true;
+			}
+			if (child.erased) {
+				child = Node{ std::move(child.name), CompoundTag{}, false, {} };
+			}
+			node = &child;
+			path = path.substr(dot + 1);
+		}
+	}
+
+	// Removes the value at `path`, if the document has one.
+	bool erase(std::string_view path) {
+		Node* node = &root;
+		while (true) {
+			if (node->value.has_value()) {
+				return remove(*node->value, path);
+			}
+			if (node->erased) {
+				return true;
+			}
+			const auto dot = path.find('.');
+			auto& child = node->child(path.substr(0, dot));
+			if (dot == std::string_view::npos) {
+				child = Node{ std::move(child.name), std::nullopt, true, {} };
+				return true;
+			}
+			node = &child;
+			path = path.substr(dot + 1);
+		}
+	}
+
+	bool dirty() const {
+		return !root.children.empty();
+	}
+
+	void clear() {
+		root = Node{};
+	}
+
+	// Appends the edited document to `out`. Fails if the source is malformed or an edit
+	// goes through a value of the source that is not a compound; `out` is then left with a
+	// partial document.
+	bool write(std::vector<std::byte>& out) const {
+		NBTFile file(source);
+		if (file.readID().value_or(ID::END) != ID::COMPOUND || !file.readStringView().has_value()) {
+			return false;
+		}
+		out.insert(out.end(), source.begin(), source.begin() + static_cast<std::ptrdiff_t>(file.position()));
+		return writeCompound(file, root, out);
+	}
+
+private:
+	// An edited key: either a new value, an erase, or edits further down in a compound.
+	struct Node {
+		std::string name{};
+		std::optional<Tag> value{};
+		bool erased = false;
+		std::vector<Node> children{};
+
+		Node& child(std::string_view key) {
+			for (auto& node : children) {
+				if (node.name == key) {
+					return node;
+				}
+			}
+			return children.emplace_back(Node{ std::string(key), std::nullopt, false, {} });
+		}
+
+		const Node* find(std::string_view key) const {
+			for (const auto& node : children) {
+				if (node.name == key) {
+					return &node;
+				}
+			}
+			return nullptr;
+		}
+	};
+
+	static bool assign(Tag& tag, std::string_view path, Tag value) {
+		auto compound = std::get_if<CompoundTag>(&tag);
+		if (compound == nullptr) {
+			return false;
+		}
+		const auto dot = path.find('.');
+		const auto key = path.substr(0, dot);
+		if (dot == std::string_view::npos) {
+			compound->erase(key);
+			compound->emplace(key, std::move(value));
+			return true;
+		}
+		if (!compound->contains(key)) {
+			compound->emplace(key, CompoundTag{ compound->resource() });
+		}
+		return assign(compound->at(key), path.substr(dot + 1), std::move(value));
+	}
+
+	static bool remove(Tag& tag, std::string_view path) {
+		auto compound = std::get_if<CompoundTag>(&tag);
+		if (compound == nullptr) {
+			return false;
+		}
+		const auto dot = path.find('.');
+		const auto key = path.substr(0, dot);
+		if (dot == std::string_view::npos) {
+			compound->erase(key);
+			return true;
+		}
+		return !compound->contains(key) || remove(compound->at(key), path.substr(dot + 1));
+	}
+
+	// Whether the edits below `node` put anything into a key that is not in the source.
+	static bool adds(const Node& node) {
+		return node.value.has_value() || std::any_of(node.children.begin(), node.children.end(), adds);
+	}
+
+	static Tag materialize(const Node& node) {
+		if (node.value.has_value()) {
+			return *node.value;
+		}
+		CompoundTag compound{};
+		for (const auto& child : node.children) {
+			if (adds(child)) {
+				compound.emplace(child.name, materialize(child));
+			}
+		}
+		return compound;
+	}
+
+	// Copies or rewrites the compound payload at the reader's position, END included.
+	bool writeCompound(NBTFile& file, const Node& node, std::vector<std::byte>& out) const {
+		const auto copy = [&](size_t begin, size_t end) {
+			out.insert(out.end(), source.begin() + static_cast<std::ptrdiff_t>(begin), source.begin() + static_cast<std::ptrdiff_t>(end));
+		};
+
+		std::vector<bool> seen(node.children.size());
+		size_t run = file.position();
+		while (true) {
+			const auto start = file.position();
+			const auto id = file.readID();
+			if (!id.has_value()) {
+				return false;
+			}
+			if (*id == ID::END) {
+				copy(run, start);
+				break;
+			}
+			const auto name = file.readStringView();
+			if (!name.has_value()) {
+				return false;
+			}
+			const auto child = node.find(*name);
+			if (child == nullptr) {
+				if (!file.skipTag(*id)) {
+					return false;
+				}
+				continue;
+			}
+
+			copy(run, start);
+			seen[static_cast<size_t>(child - node.children.data())] = true;
+			if (child->value.has_value() || child->erased) {
+				if (!file.skipTag(*id) || (child->value.has_value() && !NBTWriter(out).writeEntry(*name, *child->value))) {
+					return false;
+				}
+			} else {
+				if (*id != ID::COMPOUND) {
+					return false;
+				}
+				copy(start, file.position());
+				if (!writeCompound(file, *child, out)) {
+					return false;
+				}
+			}
+			run = file.position();
+		}
+
+		for (size_t i = 0; i < node.children.size(); ++i) {
+			const auto& child = node.children[i];
+			if (seen[i] || !adds(child)) {
+				continue;
+			}
+			if (!NBTWriter(out).writeEntry(child.name, materialize(child))) {
+				return false;
+			}
+		}
+		out.push_back(static_cast<std::byte>(ID::END));
+		return true;
+	}
+
+	std::span<const std::byte> source;
+	Node root{};
+};
@@ -0,0 +1,274 @@
+#pragma once
+
+#include "nbt.hpp"
+
+// Where every value reachable through compounds lives in an uncompressed Java document,
+// built in one pass that walks compounds and skips everything else. A lookup is a hash of
+// the path and one probe, after which only the target is decoded, or with view() only
+// measured. Paths are dot-separated keys from the root compound, such as
+// "Data.Player.Inventory"; "" is the root itself. A '.' or '\' inside a key is escaped
+// with a backslash, so the key "a.b" is the path "a\.b" and cannot collide with the
+// nested path "a.b"; escapePath() appends one key this way. Lists are indexed as a whole,
+// and their elements are reached through view().
+//
+// An index can be saved next to the document and loaded again, which checks that the
+// document still has the size and hash it was built from. The hash reads eight bytes per
+// step in four independent lanes, so checking it costs far less than a rebuild; it detects
+// stale documents, not deliberate collisions.
+struct NBTIndex {
+	using ID = TagID;
+
+	// Position of a value's payload in the document.
+	struct Entry {
+		ID id;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	static std::optional<NBTIndex> build(std::span<const std::byte> document, size_t maxDepth = NBTFile::MAX_DEPTH) {
+		NBTFile file(document);
+		if (file.readID().value_or(ID::END) != ID::COMPOUND || !file.readStringView().has_value()) {
+			return std::nullopt;
+		}
+		NBTIndex index{};
+		index.documentSize = document.size();
+		index.documentHash = hash(document);
+		std::string path{};
+		if (!index.walk(file, path, 0, maxDepth)) {
+			return std::nullopt;
+		}
+		index.rehash();
+		return index;
+	}
+
+	// Appends `key` to `path` with '.' and '\' escaped.
+	static void escapePath(std::string& path, std::string_view key) {
+		for (const auto c : key) {
+			if (c == '.' || c == '\\') {
+				path.push_back('\\');
+			}
+			path.push_back(c);
+		}
+	}
+
+	std::optional<Entry> find(std::string_view path) const {
+		if (slots.empty()) {
+			return std::nullopt;
+		}
+		const auto mask = slots.size() - 1;
+		for (auto i = nameHash(path) & mask; slots[i] != 0; i = (i + 1) & mask) {
+			const auto& entry = entries[slots[i] - 1];
+			if (pathOf(entry) == path) {
+				return Entry{ entry.id, entry.offset, entry.size };
+			}
+		}
+		return std::nullopt;
+	}
+
+	// The value at `path` without decoding it; `document` is the one the index was built from.
+	// The value is measured first, so a document that changed since the index was loaded
+	// without verification yields nothing rather than a view over malformed bytes.
+	std::optional<TagView> view(std::span<const std::byte> document, std::string_view path) const {
+		const auto entry = find(path);
+		if (!entry.has_value() || !contains(document, *entry)) {
+			return std::nullopt;
+		}
+		const auto payload = document.subspan(entry->offset, entry->size);
+		if (TagView::measure(entry->id, payload) != entry->size) {
+			return std::nullopt;
+		}
+		return TagView(entry->id, payload);
+	}
+
+	std::optional<Tag> read(std::span<const std::byte> document, std::string_view path, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const {
+		const auto entry = find(path);
+		if (!entry.has_value() || !contains(document, *entry)) {
+			return std::nullopt;
+		}
+		return NBTFile(document.subspan(entry->offset, entry->size), resource).readPayload(entry->id);
+	}
+
+	size_t size() const {
+		return entries.size();
+	}
+
+	// Appends the sidecar form: a header, the entries and the paths, all little-endian.
+	void save(std::vector<std::byte>& out) const {
+		const auto start = out.size();
+		out.resize(start + HEADER_SIZE + entries.size() * ENTRY_SIZE + paths.size());
+		auto p = out.data() + start;
+		std::memcpy(p, MAGIC.data(), MAGIC.size());
+		storeEndian<std::endian::little, uint32_t>(p + 4, VERSION);
+		storeEndian<std::endian::little, uint64_t>(p + 8, documentSize);
+		storeEndian<std::endian::little, uint64_t>(p + 16, documentHash);
+		storeEndian<std::endian::little, uint64_t>(p + 24, entries.size());
+		storeEndian<std::endian::little, uint64_t>(p + 32, paths.size());
+		p += HEADER_SIZE;
+		for (const auto& entry : entries) {
+			storeEndian<std::endian::little, uint8_t>(p, static_cast<uint8_t>(entry.id));
+			storeEndian<std::endian::little, uint32_t>(p + 1, entry.pathLength);
+			storeEndian<std::endian::little, uint64_t>(p + 5, entry.pathOffset);
+			storeEndian<std::endian::little, uint64_t>(p + 13, entry.offset);
+			storeEndian<std::endian::little, uint64_t>(p + 21, entry.size);
+			p += ENTRY_SIZE;
+		}
+		std::memcpy(p, paths.data(), paths.size());
+	}
+
+	// Reads a sidecar written by save(). Fails if it is malformed or was built from a
+	// different document. With `verify` false only the document's size is compared, for
+	// callers that already know the document is unchanged, such as by its modification time.
+	static std::optional<NBTIndex> load(std::span<const std::byte> sidecar, std::span<const std::byte> document, bool verify = true) {
+		if (sidecar.size() < HEADER_SIZE || std::memcmp(sidecar.data(), MAGIC.data(), MAGIC.size()) != 0) {
+			return std::nullopt;
+		}
+		auto p = sidecar.data();
+		NBTIndex index{};
+		index.documentSize = loadEndian<std::endian::little, uint64_t>(p + 8);
+		index.documentHash = loadEndian<std::endian::little, uint64_t>(p + 16);
+		const auto count = loadEndian<std::endian::little, uint64_t>(p + 24);
+		const auto length = loadEndian<std::endian::little, uint64_t>(p + 32);
+		if (loadEndian<std::endian::little, uint32_t>(p + 4) != VERSION || index.documentSize != document.size()) {
+			return std::nullopt;
+		}
+		if (count > (sidecar.size() - HEADER_SIZE) / ENTRY_SIZE || length != sidecar.size() - HEADER_SIZE - count * ENTRY_SIZE) {
+			return std::nullopt;
+		}
+		if (verify && index.documentHash != hash(document)) {
+			return std::nullopt;
+		}
+
+		p += HEADER_SIZE;
+		index.entries.reserve(count);
+		for (uint64_t i = 0; i < count; ++i, p += ENTRY_SIZE) {
+			Stored entry{};
+			const auto id = loadEndian<std::endian::little, uint8_t>(p);
+			entry.id = static_cast<ID>(id);
+			entry.pathLength = loadEndian<std::endian::little, uint32_t>(p + 1);
+			entry.pathOffset = loadEndian<std::endian::little, uint64_t>(p + 5);
+			entry.offset = loadEndian<std::endian::little, uint64_t>(p + 13);
+			entry.size = loadEndian<std::endian::little, uint64_t>(p + 21);
+			if (id < static_cast<uint8_t>(ID::BYTE) || id > static_cast<uint8_t>(ID::LONG_ARRAY) || entry.pathOffset > length
+				|| entry.pathLength > length - entry.pathOffset || entry.offset > document.size() || entry.size > document.size() - entry.offset) {
+				return std::nullopt;
+			}
+			index.entries.push_back(entry);
+		}
+		index.paths.assign(reinterpret_cast<const char*>(p), length);
+		index.rehash();
+		return index;
+	}
+
+private:
+	static constexpr std::array<char, 4> MAGIC{ 'N', 'B', 'T', 'I' };
+	static constexpr uint32_t VERSION = 2;
+	static constexpr size_t HEADER_SIZE = 40;
+	static constexpr size_t ENTRY_SIZE = 29;
+
+	// Paths are kept in one string, so that the index is a few flat allocations.
+	struct Stored {
+		ID id;
+		uint32_t pathLength;
+		uint64_t pathOffset;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	static uint64_t hash(std::span<const std::byte> document) {
+		constexpr uint64_t K1 = 0x9e3779b97f4a7c15;
+		constexpr uint64_t K2 = 0xc2b2ae3d27d4eb4f;
+		std::array<uint64_t, 4> lanes{ K1, K2, K1 ^ K2, K1 + K2 };
+		const auto p = document.data();
+		size_t i = 0;
+		for (; i + 32 <= document.size(); i += 32) {
+			for (size_t lane = 0; lane < 4; ++lane) {
+				const auto word = loadEndian<std::endian::little, uint64_t>(p + i + lane * 8);
+				lanes[lane] = std::rotl(lanes[lane] ^ (word * K2), 31) * K1;
+			}
+		}
+		uint64_t h = document.size() * K1;
+		for (const auto lane : lanes) {
+			h = std::rotl(h ^ lane, 27) * K2;
+		}
+		h ^= nameHash(std::string_view(reinterpret_cast<const char*>(p + i), document.size() - i));
+		h ^= h >> 33;
+		h *= K2;
+		return h ^ (h >> 29);
+	}
+
+	static bool contains(std::span<const std::byte> document, const Entry& entry) {
+		return entry.offset <= document.size() && entry.size <= document.size() - entry.offset;
+	}
+
+	std::string_view pathOf(const Stored& entry) const {
+		return std::string_view(paths).substr(entry.pathOffset, entry.pathLength);
+	}
+
+	size_t add(ID id, std::string_view path, size_t offset) {
+		entries.push_back(Stored{ id, static_cast<uint32_t>(path.size()), paths.size(), offset, 0 });
+		paths.append(path);
+		return entries.size() - 1;
+	}
+
+	// Indexes the compound payload at the reader's position, END included, under `path`.
+	bool walk(NBTFile& file, std::string& path, size_t depth, size_t maxDepth) {
+		if (depth >= maxDepth) {
+			return false;
+		}
+		const auto self = add(ID::COMPOUND, path, file.position());
+		const auto prefix = path.size();
+		while (true) {
+			const auto id = file.readID();
+			if (!id.has_value()) {
+				return false;
+			}
+			if (*id == ID::END) {
+				break;
+			}
+			const auto name = file.readStringView();
+			if (!name.has_value()) {
+				return false;
+			}
+			if (prefix != 0) {
+				path.push_back('.');
+			}
+			escapePath(path, *name);
+			if (*id == ID::COMPOUND) {
+				if (!walk(file, path, depth + 1, maxDepth)) {
+					return false;
+				}
+			} else {
+				const auto entry = add(*id, path, file.position());
+				if (!file.skipTag(*id)) {
+					return false;
+				}
+				entries[entry].size = file.position() - entries[entry].offset;
+			}
+			path.resize(prefix);
+		}
+		entries[self].size = file.position() - entries[self].offset;
+		return true;
+	}
+
+	// Open addressing at load factor 1/2 or less; the first of any duplicate paths wins.
+	void rehash() {
+		slots.assign(std::bit_ceil(std::max<size_t>(entries.size() * 2, 2)), 0);
+		const auto mask = slots.size() - 1;
+		for (size_t i = 0; i < entries.size(); ++i) {
+			const auto path = pathOf(entries[i]);
+			auto slot = nameHash(path) & mask;
+			while (slots[slot] != 0 && pathOf(entries[slots[slot] - 1]) != path) {
+				slot = (slot + 1) & mask;
+			}
+			if (slots[slot] == 0) {
+				slots[slot] = static_cast<uint32_t>(i + 1);
+			}
+		}
+	}
+
+	std::vector<Stored> entries{};
+	std::string paths{};
+	std::vector<uint32_t> slots{};
+	uint64_t documentSize = 0;
+	uint64_t documentHash = 0;
+};
@@ -6,12 +6,155 @@
 #include <string>
 #include <array>
 #include <span>
-#include <list>
-#include <map>
+#include <tuple>
+#include <utility>
+#include <memory_resource>
+#include <algorithm>
+#include <string_view>
+#include <stdexcept>
+#include <shared_mutex>
+#include <unordered_set>
+#include <mutex>
+#include <compare>
+#include <initializer_list>
 #include <bit>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(NBT_ENABLE_STATS)
+#include <atomic>
+#include <chrono>
+#include <functional>
+#endif
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+template <typename T>
+constexpr T byteswap(T value) {
+#if __cpp_lib_byteswap
+	return std::byteswap(value);
+#else
+	auto bytes = std::bit_cast<std::array<std::byte, sizeof(T)>>(value);
+	for (size_t i = 0; i < sizeof(T) / 2; ++i) {
+		std::swap(bytes[i], bytes[sizeof(T) - 1 - i]);
+	}
+	return std::bit_cast<T>(bytes);
+#endif
+}
+
+// Reverses the byte order of `count` elements. Tolerates unaligned `src`/`dst`, so it can
+// be used directly on the input span.
+template <typename T>
+void copyByteSwapped(void* dst, const void* src, size_t count) {
+	static_assert(std::is_integral_v<T>);
+
+	if constexpr (sizeof(T) == 1) {
+		std::memcpy(dst, src, count);
+	} else {
+		auto out = static_cast<char*>(dst);
+		auto in = static_cast<const char*>(src);
+		size_t i = 0;
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+		const auto mask = [] {
+			if constexpr (sizeof(T) == 2) {
+				return _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+			} else if constexpr (sizeof(T) == 4) {
+				return _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+			} else {
+				return _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+			}
+		}();
+#if defined(__AVX2__)
+		const auto mask256 = _mm256_broadcastsi128_si256(mask);
+		for (; i + 32 / sizeof(T) <= count; i += 32 / sizeof(T)) {
+			const auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i * sizeof(T)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * sizeof(T)), _mm256_shuffle_epi8(v, mask256));
+		}
+#endif
+		for (; i + 16 / sizeof(T) <= count; i += 16 / sizeof(T)) {
+			const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * sizeof(T)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * sizeof(T)), _mm_shuffle_epi8(v, mask));
+		}
+#elif defined(__ARM_NEON)
+		for (; i + 16 / sizeof(T) <= count; i += 16 / sizeof(T)) {
+			const auto v = vld1q_u8(reinterpret_cast<const uint8_t*>(in + i * sizeof(T)));
+			if constexpr (sizeof(T) == 2) {
+				vst1q_u8(reinterpret_cast<uint8_t*>(out + i * sizeof(T)), vrev16q_u8(v));
+			} else if constexpr (sizeof(T) == 4) {
+				vst1q_u8(reinterpret_cast<uint8_t*>(out + i * sizeof(T)), vrev32q_u8(v));
+			} else {
+				vst1q_u8(reinterpret_cast<uint8_t*>(out + i * sizeof(T)), vrev64q_u8(v));
+			}
+		}
+#endif
+		for (; i < count; ++i) {
+			T value;
+			std::memcpy(&value, in + i * sizeof(T), sizeof(T));
+			value = byteswap(value);
+			std::memcpy(out + i * sizeof(T), &value, sizeof(T));
+		}
+	}
+}
+
+// Converts `count` elements between the given byte order and host order, in either direction.
+// `dst` may be null when `count` is 0, as it is for the data() of an empty vector.
+template <std::endian Order, typename T>
+void copyEndian(void* dst, const void* src, size_t count) {
+	if (count == 0) {
+		return;
+	}
+	if constexpr (Order == std::endian::native) {
+		std::memcpy(dst, src, count * sizeof(T));
+	} else {
+		copyByteSwapped<T>(dst, src, count);
+	}
+}
+
+template <typename T>
+void copyBigEndian(void* dst, const void* src, size_t count) {
+	copyEndian<std::endian::big, T>(dst, src, count);
+}
+
+template <std::endian Order, typename T>
+T loadEndian(const std::byte* src) {
+	T value;
+	std::memcpy(&value, src, sizeof(T));
+	if constexpr (Order != std::endian::native) {
+		return byteswap(value);
+	} else {
+		return value;
+	}
+}
+
+template <std::endian Order, typename T>
+void storeEndian(std::byte* dst, T value) {
+	if constexpr (Order != std::endian::native) {
+		value = byteswap(value);
+	}
+	std::memcpy(dst, &value, sizeof(T));
+}
+
+template <typename T>
+T loadBigEndian(const std::byte* src) {
+	return loadEndian<std::endian::big, T>(src);
+}
+
+template <typename T>
+void storeBigEndian(std::byte* dst, T value) {
+	storeEndian<std::endian::big, T>(dst, value);
+}
 
 struct Tag;
 
+template <typename Format>
+struct BasicNBTFile;
+
 struct EndTag {};
 
 struct ByteTag {
@@ -39,13 +182,14 @@ struct DoubleTag {
 };
 
 struct StringTag {
-	std::string value;
+	std::pmr::string value;
 };
 
 template <typename T>
 struct ArrayTag {
 	ArrayTag() = default;
-	explicit ArrayTag(std::vector<T> value) : value(std::move(value)) {}
+	explicit ArrayTag(std::pmr::memory_resource* resource) : value(resource) {}
+	explicit ArrayTag(std::pmr::vector<T> value) : value(std::move(value)) {}
 
 	size_t size() const {
 		return value.size();
@@ -59,6 +203,14 @@ struct ArrayTag {
 		value.reserve(count);
 	}
 
+	T* data() {
+		return value.data();
+	}
+
+	const T* data() const {
+		return value.data();
+	}
+
 	void resize(size_t size) {
 		value.resize(size);
 	}
@@ -121,21 +273,131 @@ struct ArrayTag {
 	}
 
 private:
-	std::vector<T> value;
+	std::pmr::vector<T> value;
 };
 
 using ByteArrayTag = ArrayTag<int8_t>;
 using IntArrayTag = ArrayTag<int32_t>;
 using LongArrayTag = ArrayTag<int64_t>;
 
+// A compound key. Either owns a copy of its characters, allocated from a memory resource,
+// or borrows a stable string such as one handed out by a NameInterner. Borrowed names from
+// the same interner are pointer-equal, which makes comparing them a single pointer compare.
+// A copy only keeps borrowing if the name is one of the interners' built-in vocabulary
+// strings, which are static; any other copy owns its characters, so a copied tree no
+// longer depends on the interner, KeySet or buffer its names were borrowed from.
+struct TagName {
+	TagName() = default;
+
+	explicit TagName(std::string_view name, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : length(name.size()) {
+		if (!name.empty()) {
+			auto storage = static_cast<char*>(resource->allocate(name.size(), 1));
+			std::memcpy(storage, name.data(), name.size());
+			ptr = storage;
+			owner = resource;
+		}
+	}
+
+	template <typename T> requires (std::is_convertible_v<const T&, std::string_view> && !std::is_convertible_v<const T&, const char*>)
+	explicit TagName(const T& name) : TagName(std::string_view(name)) {}
+
+	explicit TagName(const char* name) : TagName(std::string_view(name)) {}
+
+	TagName(const TagName& other);
+
+	TagName(TagName&& other) noexcept
+		: ptr(std::exchange(other.ptr, "")), length(std::exchange(other.length, 0)), owner(std::exchange(other.owner, nullptr)) {}
+
+	TagName& operator=(TagName other) noexcept {
+		std::swap(ptr, other.ptr);
+		std::swap(length, other.length);
+		std::swap(owner, other.owner);
+		return *this;
+	}
+
+	~TagName() {
+		if (owner != nullptr) {
+			owner->deallocate(const_cast<char*>(ptr), length, 1);
+		}
+	}
+
+	static TagName interned(std::string_view name) {
+		TagName result{};
+		result.ptr = name.data();
+		result.length = name.size();
+		return result;
+	}
+
+	bool isInterned() const {
+		return owner == nullptr;
+	}
+
+	const char* data() const {
+		return ptr;
+	}
+
+	size_t size() const {
+		return length;
+	}
+
+	std::string_view view() const {
+		return { ptr, length };
+	}
+
+	operator std::string_view() const {
+		return view();
+	}
+
+	friend bool operator==(const TagName& a, const TagName& b) {
+		return (a.ptr == b.ptr && a.length == b.length) || a.view() == b.view();
+	}
+
+	friend bool operator==(const TagName& a, std::string_view b) {
+		return a.view() == b;
+	}
+
+	friend std::strong_ordering operator<=>(const TagName& a, const TagName& b) {
+		if (a.ptr == b.ptr && a.length == b.length) {
+			return std::strong_ordering::equal;
+		}
+		return a.view() <=> b.view();
+	}
+
+	friend std::strong_ordering operator<=>(const TagName& a, std::string_view b) {
+		return a.view() <=> b;
+	}
+
+private:
+	const char* ptr = "";
+	size_t length = 0;
+	std::pmr::memory_resource* owner = nullptr;
+};
+
+// Entries are kept in a flat vector sorted by name, which keeps the typical 5-30 key
+// compound in a few cache lines and makes lookups a binary search over string_views.
+// Names must not be modified through iterators.
 struct CompoundTag {
+	using value_type = std::pair<TagName, Tag>;
+	using storage_type = std::pmr::vector<value_type>;
+	using iterator = storage_type::iterator;
+	using const_iterator = storage_type::const_iterator;
+
 	CompoundTag() = default;
-	explicit CompoundTag(std::map<std::string, Tag> value) : value(std::move(value)) {}
+	explicit CompoundTag(std::pmr::memory_resource* resource) : value(resource) {}
+	explicit CompoundTag(storage_type value);
 
 	auto size() const {
 		return value.size();
 	}
 
+	bool empty() const {
+		return value.empty();
+	}
+
+	void reserve(size_t count) {
+		value.reserve(count);
+	}
+
 	void clear() {
 		value.clear();
 	}
@@ -157,50 +419,86 @@ struct CompoundTag {
 	}
 
 	template <typename T>
-	void emplace(std::string name, T&& tag) {
-		value.emplace(std::move(name), std::forward<T>(tag));
-	}
-
-	Tag& at(const std::string& name) {
-		return value.at(name);
+	void emplace(std::string_view name, T&& tag) {
+		auto it = lowerBound(name);
+		if (!matches(it, name)) {
+			value.emplace(it, std::piecewise_construct, std::forward_as_tuple(name, resource()), std::forward_as_tuple(std::forward<T>(tag)));
+		}
 	}
 
-	const Tag& at(const std::string& name) const {
-		return value.at(name);
+	template <typename T>
+	void emplace(TagName name, T&& tag) {
+		auto it = lowerBound(name);
+		if (!matches(it, name)) {
+			value.emplace(it, std::piecewise_construct, std::forward_as_tuple(std::move(name)), std::forward_as_tuple(std::forward<T>(tag)));
+		}
 	}
 
-	auto erase(const std::string& name) {
-		return value.erase(name);
-	}
+	Tag& at(std::string_view name);
+	const Tag& at(std::string_view name) const;
 
-	auto find(const std::string& name) {
-		return value.find(name);
-	}
+	size_t erase(std::string_view name);
 
-	auto find(const std::string& name) const {
-		return value.find(name);
-	}
+	iterator find(std::string_view name);
+	const_iterator find(std::string_view name) const;
+	bool contains(std::string_view name) const;
 
-	bool contains(const std::string& name) const {
-		return value.contains(name);
+	std::pmr::memory_resource* resource() const {
+		return value.get_allocator().resource();
 	}
 
 private:
-	std::map<std::string, Tag> value;
+	template <typename Format>
+	friend struct BasicNBTFile;
+
+	iterator lowerBound(std::string_view name);
+	bool matches(const_iterator it, std::string_view name) const;
+	void normalize();
+
+	storage_type value;
 };
 
 struct ListTag {
 	ListTag() = default;
-	explicit ListTag(std::list<Tag> value) : value(std::move(value)) {}
+	explicit ListTag(std::pmr::memory_resource* resource) : value(resource) {}
+	explicit ListTag(std::pmr::vector<Tag> value) : value(std::move(value)) {}
 
 	auto size() const {
 		return value.size();
 	}
 
+	bool empty() const {
+		return value.empty();
+	}
+
+	size_t capacity() const {
+		return value.capacity();
+	}
+
+	void reserve(size_t count) {
+		value.reserve(count);
+	}
+
 	void clear() {
 		value.clear();
 	}
 
+	Tag& at(size_t i) {
+		return value.at(i);
+	}
+
+	const Tag& at(size_t i) const {
+		return value.at(i);
+	}
+
+	Tag& operator[](size_t i) {
+		return value[i];
+	}
+
+	const Tag& operator[](size_t i) const {
+		return value[i];
+	}
+
 	auto begin() {
 		return value.begin();
 	}
@@ -223,9 +521,15 @@ struct ListTag {
 	}
 
 private:
-	std::list<Tag> value;
+	std::pmr::vector<Tag> value;
 };
 
+// Thread safety: the tag types are safe to read from any number of threads at once as long
+// as none of them modifies the tree; const member functions never write, allocate or touch
+// the memory resource. Modifying or destroying a tree needs exclusive access, so trees that
+// are shared between threads should be held through NBTDocument (cache.hpp) or built from
+// PersistentTag (persistent.hpp). Readers, writers and views are used by one thread at a
+// time; NameInterner and ThreadPool are thread-safe.
 struct Tag : std::variant<
 	EndTag,
 	ByteTag,
@@ -244,85 +548,546 @@ struct Tag : std::variant<
 	using variant::variant;
 };
 
-struct NBTFile {
-	enum class ID {
-		END = 0,
-		BYTE = 1,
-		SHORT = 2,
-		INT = 3,
-		LONG = 4,
-		FLOAT = 5,
-		DOUBLE = 6,
-		BYTE_ARRAY = 7,
-		STRING = 8,
-		LIST = 9,
-		COMPOUND = 10,
-		INT_ARRAY = 11,
-		LONG_ARRAY = 12,
+inline CompoundTag::CompoundTag(storage_type entries) : value(std::move(entries)) {
+	normalize();
+}
+
+inline void CompoundTag::normalize() {
+	auto less = [](const value_type& a, const value_type& b) {
+		return a.first < b.first;
 	};
-	
-	explicit NBTFile(std::span<const std::byte> data) : data(data) {}
+	// Stable so that the first of any duplicate names wins, as with insertion through emplace().
+	// Insertion sort keeps the common small compound free of temporary buffer allocations.
+	if (value.size() <= 32) {
+		for (size_t i = 1; i < value.size(); ++i) {
+			for (size_t j = i; j > 0 && less(value[j], value[j - 1]); --j) {
+				std::swap(value[j], value[j - 1]);
+			}
+		}
+	} else {
+		std::stable_sort(value.begin(), value.end(), less);
+	}
+	auto last = std::unique(value.begin(), value.end(), [](const value_type& a, const value_type& b) {
+		return a.first == b.first;
+	});
+	value.erase(last, value.end());
+}
+
+inline CompoundTag::iterator CompoundTag::lowerBound(std::string_view name) {
+	return std::lower_bound(value.begin(), value.end(), name, [](const value_type& entry, std::string_view name) {
+		return entry.first < name;
+	});
+}
+
+inline bool CompoundTag::matches(const_iterator it, std::string_view name) const {
+	return it != value.end() && it->first == name;
+}
+
+inline CompoundTag::iterator CompoundTag::find(std::string_view name) {
+	auto it = lowerBound(name);
+	return matches(it, name) ? it : value.end();
+}
+
+inline CompoundTag::const_iterator CompoundTag::find(std::string_view name) const {
+	return const_cast<CompoundTag*>(this)->find(name);
+}
+
+inline bool CompoundTag::contains(std::string_view name) const {
+	return find(name) != end();
+}
+
+inline Tag& CompoundTag::at(std::string_view name) {
+	if (auto it = find(name); it != value.end()) {
+		return it->second;
+	}
+	throw std::out_of_range("CompoundTag::at");
+}
 
-	template <typename T>
-	std::optional<T> readTag() = delete;
+inline const Tag& CompoundTag::at(std::string_view name) const {
+	if (auto it = find(name); it != value.end()) {
+		return it->second;
+	}
+	throw std::out_of_range("CompoundTag::at");
+}
 
-	std::optional<int8_t> readI8() {
-		if (pos > data.size()) {
-			return std::nullopt;
+inline size_t CompoundTag::erase(std::string_view name) {
+	if (auto it = find(name); it != value.end()) {
+		value.erase(it);
+		return 1;
+	}
+	return 0;
+}
+
+constexpr uint64_t nameHash(std::string_view name) {
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : name) {
+		hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+	}
+	return hash;
+}
+
+// A fixed set of key names with a perfect hash built at compile time (hash and displace):
+// find() costs one nameHash, one multiply and one comparison, and never probes. Keys must
+// be string literals or other constants, so the views stay valid for the whole program.
+template <size_t N>
+struct KeySet {
+	static_assert(N < UINT16_MAX);
+
+	template <typename... Keys> requires (sizeof...(Keys) == N && (std::is_convertible_v<const Keys&, std::string_view> && ...))
+	consteval explicit KeySet(const Keys&... keys) : KeySet(std::array<std::string_view, N>{ std::string_view(keys)... }) {}
+
+	consteval explicit KeySet(const std::array<std::string_view, N>& keys) : keys(keys) {
+		std::array<uint64_t, N> hashes{};
+		for (size_t i = 0; i < N; ++i) {
+			hashes[i] = nameHash(keys[i]);
+			for (size_t j = 0; j < i; ++j) {
+				if (keys[i] == keys[j]) {
+					throw std::logic_error("duplicate key in KeySet");
+				}
+			}
+		}
+
+		std::array<size_t, BUCKETS> sizes{};
+		for (auto hash : hashes) {
+			++sizes[hash & (BUCKETS - 1)];
+		}
+		std::array<size_t, BUCKETS> order{};
+		for (size_t b = 0; b < BUCKETS; ++b) {
+			order[b] = b;
+		}
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+			return sizes[a] > sizes[b];
+		});
+
+		slots.fill(EMPTY);
+		for (auto bucket : order) {
+			if (sizes[bucket] == 0) {
+				break;
+			}
+			for (uint32_t seed = 0;; ++seed) {
+				if (seed == UINT16_MAX) {
+					throw std::logic_error("no perfect hash for KeySet");
+				}
+				auto trial = slots;
+				bool placed = true;
+				for (size_t i = 0; i < N && placed; ++i) {
+					if ((hashes[i] & (BUCKETS - 1)) == bucket) {
+						auto& slot = trial[mix(hashes[i], seed)];
+						placed = slot == EMPTY;
+						slot = static_cast<uint16_t>(i);
+					}
+				}
+				if (placed) {
+					slots = trial;
+					seeds[bucket] = seed;
+					break;
+				}
+			}
 		}
-		return std::bit_cast<int8_t>(data[pos++]);
 	}
 
-	std::optional<int16_t> readI16() {
-		if (pos + 2 > data.size()) {
+	static constexpr size_t size() {
+		return N;
+	}
+
+	constexpr std::string_view operator[](size_t i) const {
+		return keys[i];
+	}
+
+	// Returns the index of `name` in the order the keys were given.
+	constexpr std::optional<size_t> find(std::string_view name) const {
+		if constexpr (N == 0) {
 			return std::nullopt;
+		} else {
+			const auto hash = nameHash(name);
+			const auto index = slots[mix(hash, seeds[hash & (BUCKETS - 1)])];
+			if (index == EMPTY || keys[index] != name) {
+				return std::nullopt;
+			}
+			return index;
 		}
+	}
+
+private:
+	static constexpr size_t BUCKETS = std::bit_ceil(std::max<size_t>(N, 1));
+	static constexpr size_t SLOTS = 2 * BUCKETS;
+	static constexpr uint16_t EMPTY = UINT16_MAX;
 
-		std::array<std::byte, 2> bytes{};
-		bytes[1] = data[pos++];
-		bytes[0] = data[pos++];
-		return std::bit_cast<int16_t>(bytes);
+	static constexpr size_t mix(uint64_t hash, uint32_t seed) {
+		return static_cast<size_t>(((hash ^ seed) * 0x9e3779b97f4a7c15ull) >> (64 - std::countr_zero(SLOTS)));
 	}
 
-	std::optional<int32_t> readI32() {
-		if (pos + 4 > data.size()) {
+	std::array<std::string_view, N> keys{};
+	std::array<uint32_t, BUCKETS> seeds{};
+	std::array<uint16_t, SLOTS> slots{};
+};
+
+template <typename... Keys>
+KeySet(const Keys&...) -> KeySet<sizeof...(Keys)>;
+
+// What NBTFile::readCompound() does with keys that are not in its KeySet.
+enum class UnknownKeys {
+	READ,
+	SKIP,
+};
+
+// Shared, thread-safe pool of compound key names. Names from the built-in vocabulary of
+// common Minecraft keys resolve without locking to the same static strings in every
+// interner; other names are copied once into interner-owned storage, up to `capacity`
+// names or `bytes` characters in total, after which intern() returns std::nullopt and
+// callers fall back to owned keys. Interned names stay valid until clear() or the end of
+// the interner's lifetime.
+struct NameInterner {
+	explicit NameInterner(size_t capacity = 1 << 16, size_t bytes = 1 << 20) : capacity(capacity), bytes(bytes) {}
+
+	NameInterner(const NameInterner&) = delete;
+	NameInterner& operator=(const NameInterner&) = delete;
+
+	static std::optional<std::string_view> known(std::string_view name) {
+		const auto mask = table.size() - 1;
+		for (auto i = nameHash(name) & mask;; i = (i + 1) & mask) {
+			if (table[i].data() == nullptr) {
+				return std::nullopt;
+			}
+			if (table[i] == name) {
+				return table[i];
+			}
+		}
+	}
+
+	std::optional<std::string_view> intern(std::string_view name) {
+		if (auto name_ = known(name)) {
+			return name_;
+		}
+		{
+			std::shared_lock lock(mutex);
+			if (auto it = names.find(name); it != names.end()) {
+				return *it;
+			}
+		}
+		std::unique_lock lock(mutex);
+		if (auto it = names.find(name); it != names.end()) {
+			return *it;
+		}
+		if (names.size() >= capacity || name.size() > bytes - used) {
 			return std::nullopt;
 		}
+		used += name.size();
+		auto storage = static_cast<char*>(arena.allocate(name.size() + 1, 1));
+		std::memcpy(storage, name.data(), name.size());
+		storage[name.size()] = '\0';
+		return *names.emplace(storage, name.size()).first;
+	}
 
-		std::array<std::byte, 4> bytes{};
-		bytes[3] = data[pos++];
-		bytes[2] = data[pos++];
-		bytes[1] = data[pos++];
-		bytes[0] = data[pos++];
-		return std::bit_cast<int32_t>(bytes);
+	size_t size() const {
+		std::shared_lock lock(mutex);
+		return names.size();
 	}
 
-	std::optional<int64_t> readI64() {
-		if (pos + 8 > data.size()) {
-			return std::nullopt;
+	// Forgets and frees every interned name; none of them may still be in use.
+	void clear() {
+		std::unique_lock lock(mutex);
+		names.clear();
+		arena.release();
+		used = 0;
+	}
+
+private:
+	struct Hash {
+		size_t operator()(std::string_view name) const {
+			return static_cast<size_t>(nameHash(name));
+		}
+	};
+
+	static constexpr std::string_view vocabulary[] = {
+		"", "DataVersion", "Level", "Status", "xPos", "yPos", "zPos", "LastUpdate", "InhabitedTime",
+		"isLightOn", "Sections", "sections", "Y", "Palette", "palette", "BlockStates", "block_states",
+		"data", "biomes", "Biomes", "Name", "Properties", "BlockLight", "SkyLight", "Heightmaps",
+		"MOTION_BLOCKING", "MOTION_BLOCKING_NO_LEAVES", "OCEAN_FLOOR", "OCEAN_FLOOR_WG", "WORLD_SURFACE",
+		"WORLD_SURFACE_WG", "Entities", "TileEntities", "block_entities", "TileTicks", "LiquidTicks",
+		"block_ticks", "fluid_ticks", "PostProcessing", "Lights", "ToBeTicked", "LiquidsToBeTicked",
+		"CarvingMasks", "Structures", "structures", "Starts", "starts", "References",
+		"keepPacked", "id", "x", "y", "z", "i", "p", "t", "Pos", "Motion", "Rotation", "UUID", "UUIDMost",
+		"UUIDLeast", "Health", "Air", "Fire", "FallDistance", "OnGround", "Invulnerable",
+		"PortalCooldown", "CustomName", "CustomNameVisible", "Silent", "NoGravity", "Glowing", "Tags",
+		"Passengers", "Items", "Item", "Inventory", "EnderItems", "HandItems", "ArmorItems",
+		"HandDropChances", "ArmorDropChances", "Count", "count", "Slot", "tag", "components", "Damage",
+		"Enchantments", "lvl", "display", "Lore", "Color", "Age", "Brain", "memories", "Attributes",
+		"Base", "Modifiers", "Amount", "Operation", "Leash", "PersistenceRequired", "CanPickUpLoot",
+		"LeftHanded", "DeathTime", "HurtTime", "HurtByTimestamp", "AbsorptionAmount", "FallFlying",
+		"ActiveEffects", "Duration", "Amplifier", "Ambient", "ShowParticles", "Variant", "Text1",
+		"Text2", "Text3", "Text4", "front_text", "back_text", "messages", "is_waxed", "pages", "title",
+		"author", "generation", "resolved", "text", "keepJigsaws", "Data", "SpawnX", "SpawnY", "SpawnZ",
+		"Time", "DayTime", "LevelName", "GameType", "Player", "Dimension", "Version", "Entity",
+		"blocks", "size", "state", "nbt", "pos", "blockPos",
+	};
+
+	static constexpr auto table = [] {
+		std::array<std::string_view, 512> slots{};
+		for (auto name : vocabulary) {
+			for (auto i = nameHash(name) & (slots.size() - 1);; i = (i + 1) & (slots.size() - 1)) {
+				if (slots[i].data() == nullptr) {
+					slots[i] = name;
+					break;
+				}
+				if (slots[i] == name) {
+					break;
+				}
+			}
+		}
+		return slots;
+	}();
+
+	size_t capacity;
+	size_t bytes;
+	size_t used = 0;
+	mutable std::shared_mutex mutex{};
+	std::unordered_set<std::string_view, Hash> names{};
+	std::pmr::monotonic_buffer_resource arena{};
+};
+
+inline TagName::TagName(const TagName& other)
+	: TagName(other.owner == nullptr && NameInterner::known(other.view()).value_or(std::string_view{}).data() == other.ptr ? interned(other.view()) : TagName(other.view())) {}
+
+enum class TagID {
+	END = 0,
+	BYTE = 1,
+	SHORT = 2,
+	INT = 3,
+	LONG = 4,
+	FLOAT = 5,
+	DOUBLE = 6,
+	BYTE_ARRAY = 7,
+	STRING = 8,
+	LIST = 9,
+	COMPOUND = 10,
+	INT_ARRAY = 11,
+	LONG_ARRAY = 12,
+};
+
+// Wire formats, passed as the Format parameter of BasicNBTFile and BasicNBTWriter. Each
+// one gets its own decode and encode loops; nothing is chosen per value at run time.
+struct JavaFormat {
+	static constexpr std::endian order = std::endian::big;
+	static constexpr bool varint = false;
+	static constexpr bool namedRoot = true;
+};
+
+// The Java protocol since 1.20.2, which sends the root compound without a name.
+struct JavaNetworkFormat : JavaFormat {
+	static constexpr bool namedRoot = false;
+};
+
+// Bedrock files, such as level.dat and LevelDB values.
+struct BedrockFormat {
+	static constexpr std::endian order = std::endian::little;
+	static constexpr bool varint = false;
+	static constexpr bool namedRoot = true;
+};
+
+// The Bedrock network protocol.
+struct BedrockNetworkFormat {
+	static constexpr std::endian order = std::endian::little;
+	// INT and LONG values and every length are zigzag varints, string lengths unsigned ones.
+	static constexpr bool varint = true;
+	static constexpr bool namedRoot = true;
+};
+
+struct ParseError {
+	enum class Kind {
+		TRUNCATED,
+		INVALID_TYPE,
+		INVALID_LENGTH,
+		INVALID_VARINT,
+		DEPTH_LIMIT,
+		INVALID_SYNTAX,
+		LIMIT_EXCEEDED,
+	};
+
+	Kind kind;
+	// Byte offset in the input of the value that could not be decoded.
+	size_t offset;
+
+	std::string_view message() const {
+		switch (kind) {
+			case Kind::TRUNCATED:
+				return "unexpected end of input";
+			case Kind::INVALID_TYPE:
+				return "invalid tag type";
+			case Kind::INVALID_LENGTH:
+				return "invalid length";
+			case Kind::INVALID_VARINT:
+				return "malformed varint";
+			case Kind::DEPTH_LIMIT:
+				return "nesting too deep";
+			case Kind::INVALID_SYNTAX:
+				return "unexpected character";
+			case Kind::LIMIT_EXCEEDED:
+				return "size limit exceeded";
+		}
+		return "unknown error";
+	}
+};
+
+// Either a value or the ParseError that prevented it; a small stand-in for std::expected.
+template <typename T>
+struct ParseResult {
+	ParseResult(T value) : result(std::in_place_index<0>, std::move(value)) {}
+	ParseResult(ParseError error) : result(std::in_place_index<1>, error) {}
+
+	bool has_value() const {
+		return result.index() == 0;
+	}
+
+	explicit operator bool() const {
+		return has_value();
+	}
+
+	T& value() {
+		return std::get<0>(result);
+	}
+
+	const T& value() const {
+		return std::get<0>(result);
+	}
+
+	T& operator*() {
+		return value();
+	}
+
+	const T& operator*() const {
+		return value();
+	}
+
+	T* operator->() {
+		return &value();
+	}
+
+	const T* operator->() const {
+		return &value();
+	}
+
+	const ParseError& error() const {
+		return std::get<1>(result);
+	}
+
+private:
+	std::variant<T, ParseError> result;
+};
+
+#if defined(NBT_ENABLE_STATS)
+// Memory resource that counts what is allocated through it. When it is the resource of a
+// reader, NBTStats includes the allocations made for each document; if it is shared, the
+// counts include whatever other threads allocated at the same time.
+struct CountingResource final : std::pmr::memory_resource {
+	explicit CountingResource(std::pmr::memory_resource* parent = std::pmr::get_default_resource()) : parent(parent) {}
+
+	std::atomic<size_t> allocations = 0;
+	std::atomic<size_t> bytes = 0;
+
+private:
+	void* do_allocate(size_t size, size_t alignment) override {
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		bytes.fetch_add(size, std::memory_order_relaxed);
+		return parent->allocate(size, alignment);
+	}
+
+	void do_deallocate(void* p, size_t size, size_t alignment) override {
+		parent->deallocate(p, size, alignment);
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+		return this == &other;
+	}
+
+	std::pmr::memory_resource* parent;
+};
+
+// Counters for one top-level document, collected only when NBT_ENABLE_STATS is defined.
+// The arrays are indexed by TagID. Times are exclusive, so a compound's time covers its
+// keys and structure but not the values inside it.
+struct NBTStats {
+	using Clock = std::chrono::steady_clock;
+
+	size_t bytes = 0;
+	std::array<size_t, 13> tags{};
+	std::array<Clock::duration, 13> time{};
+	size_t allocations = 0;
+	size_t allocatedBytes = 0;
+	size_t maxDepth = 0;
+	bool ok = false;
+
+	// Called on the parsing thread after each document read with read() or parse(). Set it
+	// before parsing starts; it has to be thread-safe if several threads parse.
+	static inline std::function<void(const NBTStats&)> onDocument{};
+};
+#endif
+
+// Every read either succeeds or returns an empty result; the first failure is also kept
+// as a ParseError with its byte offset, and parse() returns it directly.
+template <typename Format>
+struct BasicNBTFile {
+	using Error = ParseError::Kind;
+	using ID = TagID;
+
+	// Deepest nesting of compounds and lists accepted by readTag() and skipTag(), the same
+	// limit Minecraft applies to untrusted input. Decoding itself does not recurse, but
+	// destroying a tree does, so the limit also bounds stack use when the result is freed.
+	static constexpr size_t MAX_DEPTH = 512;
+
+	explicit BasicNBTFile(std::span<const std::byte> data, std::pmr::memory_resource* resource = std::pmr::get_default_resource(), NameInterner* names = nullptr, size_t maxDepth = MAX_DEPTH)
+		: data(data), resource(resource), names(names), maxDepth(maxDepth) {}
+
+	// Starts over on new input, keeping the allocation and any spilled stack frames.
+	void reset(std::span<const std::byte> input) {
+		data = input;
+		pos = 0;
+		failure.reset();
+	}
+
+	// Decodes the payload of a T, one of the Tag alternatives. Each type is read by an
+	// overload taking its std::type_identity.
+	template <typename T>
+	std::optional<T> readTag() {
+		return readTag(std::type_identity<T>{});
+	}
+
+	std::optional<int8_t> readI8() {
+		if (pos >= data.size()) {
+			return fail(Error::TRUNCATED, pos);
+		}
+		return std::bit_cast<int8_t>(data[pos++]);
+	}
+
+	std::optional<int16_t> readI16() {
+		return readFixed<int16_t>();
+	}
+
+	std::optional<int32_t> readI32() {
+		if constexpr (Format::varint) {
+			return readVarint<int32_t>();
+		} else {
+			return readFixed<int32_t>();
 		}
+	}
 
-		std::array<std::byte, 8> bytes{};
-		bytes[7] = data[pos++];
-		bytes[6] = data[pos++];
-		bytes[5] = data[pos++];
-		bytes[4] = data[pos++];
-		bytes[3] = data[pos++];
-		bytes[2] = data[pos++];
-		bytes[1] = data[pos++];
-		bytes[0] = data[pos++];
-		return std::bit_cast<int64_t>(bytes);
+	std::optional<int64_t> readI64() {
+		if constexpr (Format::varint) {
+			return readVarint<int64_t>();
+		} else {
+			return readFixed<int64_t>();
+		}
 	}
 
 	std::optional<float> readF32() {
-		if (auto i32 = readI32()) {
+		if (auto i32 = readFixed<int32_t>()) {
 			return std::bit_cast<float>(*i32);
 		}
 		return std::nullopt;
 	}
 
 	std::optional<double> readF64() {
-		if (auto i64 = readI64()) {
+		if (auto i64 = readFixed<int64_t>()) {
 			return std::bit_cast<double>(*i64);
 		}
 		return std::nullopt;
@@ -335,120 +1100,306 @@ struct NBTFile {
 		return std::nullopt;
 	}
 
-	std::optional<std::string> readString() {
-		if (auto size = readI16()) {
-			if (pos + *size > data.size()) {
+	std::optional<std::string_view> readStringView() {
+		const auto start = pos;
+		size_t length = 0;
+		if constexpr (Format::varint) {
+			auto size = readVarUInt<uint32_t>();
+			if (!size.has_value()) {
 				return std::nullopt;
 			}
-			const auto bytes = data.subspan(pos, static_cast<size_t>(*size));
-			pos += bytes.size();
-
-			return std::string(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+			length = *size;
+		} else {
+			auto size = readI16();
+			if (!size.has_value()) {
+				return std::nullopt;
+			}
+			length = static_cast<uint16_t>(*size);
 		}
-		return std::nullopt;
+		if (length > data.size() - pos) {
+			return fail(Error::TRUNCATED, start);
+		}
+		const auto bytes = data.subspan(pos, length);
+		pos += bytes.size();
 
+		return std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size());
 	}
 
-	template <>
-	std::optional<ByteTag> readTag() {
-		if (auto i8 = readI8()) {
-			return ByteTag{ *i8 };
+	std::optional<std::string> readString() {
+		if (auto str = readStringView()) {
+			return std::string(*str);
 		}
 		return std::nullopt;
 	}
 
-	template <>
-	std::optional<ShortTag> readTag() {
+	size_t position() const {
+		return pos;
+	}
+
+	// Encoded size of a tag whose payload has the same size for every value.
+	static std::optional<size_t> fixedSize(ID id) {
+		switch (id) {
+			case ID::END:
+				return 0;
+			case ID::BYTE:
+				return 1;
+			case ID::SHORT:
+				return 2;
+			case ID::INT:
+				return Format::varint ? std::nullopt : std::optional<size_t>(4);
+			case ID::FLOAT:
+				return 4;
+			case ID::LONG:
+				return Format::varint ? std::nullopt : std::optional<size_t>(8);
+			case ID::DOUBLE:
+				return 8;
+			default:
+				return std::nullopt;
+		}
+	}
+
+	bool skip(size_t size) {
+		if (size > data.size() - pos) {
+			fail(Error::TRUNCATED, pos);
+			return false;
+		}
+		pos += size;
+		return true;
+	}
+
+	size_t remaining() const {
+		return data.size() - pos;
+	}
+
+	std::optional<std::span<const std::byte>> readBytes(size_t size) {
+		if (size > data.size() - pos) {
+			return fail(Error::TRUNCATED, pos);
+		}
+		const auto bytes = data.subspan(pos, size);
+		pos += size;
+		return bytes;
+	}
+
+	bool skipTag(ID id) {
+		if (auto size = fixedSize(id)) {
+			return skip(*size);
+		}
+		const auto base = frames.size();
+		const auto unwind = [&] {
+			frames.resize(base);
+			return false;
+		};
+
+		while (true) {
+			switch (id) {
+				case ID::INT:
+					if (!readI32().has_value()) {
+						return unwind();
+					}
+					break;
+				case ID::LONG:
+					if (!readI64().has_value()) {
+						return unwind();
+					}
+					break;
+				case ID::BYTE_ARRAY:
+					if (!skipArray<int8_t>()) {
+						return unwind();
+					}
+					break;
+				case ID::INT_ARRAY:
+					if (!skipArray<int32_t>()) {
+						return unwind();
+					}
+					break;
+				case ID::LONG_ARRAY:
+					if (!skipArray<int64_t>()) {
+						return unwind();
+					}
+					break;
+				case ID::STRING:
+					if (!readStringView().has_value()) {
+						return unwind();
+					}
+					break;
+				case ID::LIST: {
+					const auto start = pos;
+					const auto element = readID();
+					const auto len = readI32();
+					if (!element.has_value() || !len.has_value()) {
+						return unwind();
+					}
+					if (*len < 0 || (*element == ID::END && *len != 0)) {
+						fail(Error::INVALID_LENGTH, start + 1);
+						return unwind();
+					}
+					const auto count = static_cast<size_t>(*len);
+					if (auto size = fixedSize(*element)) {
+						if (*size != 0 && count > (data.size() - pos) / *size) {
+							fail(Error::TRUNCATED, pos);
+							return unwind();
+						}
+						pos += count * *size;
+						break;
+					}
+					if (frames.size() - base >= maxDepth) {
+						fail(Error::DEPTH_LIMIT, start);
+						return unwind();
+					}
+					frames.push_back(Frame{ ID::LIST, *element, count, nullptr, nullptr });
+					break;
+				}
+				case ID::COMPOUND:
+					if (frames.size() - base >= maxDepth) {
+						fail(Error::DEPTH_LIMIT, pos);
+						return unwind();
+					}
+					frames.push_back(Frame{ ID::COMPOUND, ID::END, 0, nullptr, nullptr });
+					break;
+				default: {
+					const auto size = fixedSize(id);
+					if (!size.has_value()) {
+						fail(Error::INVALID_TYPE, pos);
+						return unwind();
+					}
+					if (!skip(*size)) {
+						return unwind();
+					}
+					break;
+				}
+			}
+
+			// Find the next value to skip, closing every container that has run out.
+			while (true) {
+				if (frames.size() == base) {
+					return true;
+				}
+				auto& top = frames.back();
+				if (top.kind == ID::LIST) {
+					if (top.remaining == 0) {
+						frames.pop_back();
+						continue;
+					}
+					--top.remaining;
+					id = top.element;
+					break;
+				}
+				const auto entry = readID();
+				if (!entry.has_value()) {
+					return unwind();
+				}
+				if (*entry == ID::END) {
+					frames.pop_back();
+					continue;
+				}
+				if (!valid(*entry)) {
+					fail(Error::INVALID_TYPE, pos - 1);
+					return unwind();
+				}
+				if (!readStringView().has_value()) {
+					return unwind();
+				}
+				id = *entry;
+				break;
+			}
+		}
+	}
+
+	std::optional<Tag> readPayload(ID id);
+
+
+	std::optional<ByteTag> readTag(std::type_identity<ByteTag>) {
+		if (auto i8 = readI8()) {
+			return ByteTag{ *i8 };
+		}
+		return std::nullopt;
+	}
+
+	std::optional<ShortTag> readTag(std::type_identity<ShortTag>) {
 		if (auto i16 = readI16()) {
 			return ShortTag{ *i16 };
 		}
 		return std::nullopt;
 	}
 
-	template <>
-	std::optional<IntTag> readTag() {
+	std::optional<IntTag> readTag(std::type_identity<IntTag>) {
 		if (auto i32 = readI32()) {
 			return IntTag{ *i32 };
 		}
 		return std::nullopt;
 	}
 
-	template <>
-	std::optional<LongTag> readTag() {
+	std::optional<LongTag> readTag(std::type_identity<LongTag>) {
 		if (auto i64 = readI64()) {
 			return LongTag{ *i64 };
 		}
 		return std::nullopt;
 	}
 
-	template <>
-	std::optional<FloatTag> readTag() {
+	std::optional<FloatTag> readTag(std::type_identity<FloatTag>) {
 		if (auto f32 = readF32()) {
 			return FloatTag{ *f32 };
 		}
 		return std::nullopt;
 	}
 
-	template <>
-	std::optional<DoubleTag> readTag() {
+	std::optional<DoubleTag> readTag(std::type_identity<DoubleTag>) {
 		if (auto f64 = readF64()) {
 			return DoubleTag{ *f64 };
 		}
 		return std::nullopt;
 	}
 
-	template <>
-	std::optional<StringTag> readTag() {
-		if (auto str = readString()) {
-			return StringTag{ std::move(*str) };
+	std::optional<StringTag> readTag(std::type_identity<StringTag>) {
+		if (auto str = readStringView()) {
+			return StringTag{ std::pmr::string(*str, resource) };
 		}
 		return std::nullopt;
 	}
 
-	template <>
-	std::optional<ListTag> readTag() {
+	std::optional<ListTag> readTag(std::type_identity<ListTag>) {
 		const auto id = readID();
 		if (!id.has_value()) {
 			return std::nullopt;
 		}
-		switch (*id) {
-			case ID::END:
-				return readListTag<EndTag>();
-			case ID::BYTE:
-				return readListTag<ByteTag>();
-			case ID::SHORT:
-				return readListTag<ShortTag>();
-			case ID::INT:
-				return readListTag<IntTag>();
-			case ID::LONG:
-				return readListTag<LongTag>();
-			case ID::FLOAT:
-				return readListTag<FloatTag>();
-			case ID::DOUBLE:
-				return readListTag<DoubleTag>();
-			case ID::BYTE_ARRAY:
-				return readListTag<ByteArrayTag>();
-			case ID::STRING:
-				return readListTag<StringTag>();
-			case ID::LIST:
-				return readListTag<ListTag>();
-			case ID::COMPOUND:
-				return readListTag<CompoundTag>();
-			case ID::INT_ARRAY:
-				return readListTag<IntArrayTag>();
-			case ID::LONG_ARRAY:
-				return readListTag<LongArrayTag>();
-			default:
-				return std::nullopt;
+		if (*id != ID::LIST && *id != ID::COMPOUND) {
+			return readList(*id);
+		}
+		ListTag list{ resource };
+		const auto count = beginList(list, *id);
+		if (!count.has_value() || !readTree(Frame{ ID::LIST, *id, *count, nullptr, &list })) {
+			return std::nullopt;
 		}
+		return list;
 	}
 
 	template <typename T>
 	std::optional<ListTag> readListTag() {
+		const auto start = pos;
 		if (auto len = readI32()) {
+			if (*len < 0) {
+				return fail(Error::INVALID_LENGTH, start);
+			}
 			const auto size = static_cast<size_t>(*len);
+			if constexpr (std::is_same_v<T, EndTag>) {
+				if (size != 0) {
+					return fail(Error::INVALID_LENGTH, start);
+				}
+			} else if (size > (data.size() - pos) / minimumSize<T>()) {
+				return fail(Error::TRUNCATED, pos);
+			}
 
-			ListTag list{};
+			ListTag list{ resource };
+			list.reserve(size);
+			if constexpr (isFixedScalar<T>()) {
+				// The whole payload was bounds-checked above.
+				using V = decltype(T::value);
+				for (size_t i = 0; i < size; ++i) {
+					list.emplace_back(T{ load<V>(data.data() + pos) });
+					pos += sizeof(V);
+				}
+				return list;
+			}
 			for (size_t i = 0; i < size; ++i) {
 				if (auto v = readTag<T>()) {
 					list.emplace_back(std::move(*v));
@@ -461,179 +1412,1427 @@ struct NBTFile {
 		return std::nullopt;
 	}
 
-	template <>
-	std::optional<ByteArrayTag> readTag() {
-		if (auto len = readI32()) {
-			const auto size = static_cast<size_t>(*len);
+	template <typename T>
+	std::optional<ArrayTag<T>> readArrayTag() {
+		const auto start = pos;
+		const auto len = readI32();
+		if (!len.has_value()) {
+			return std::nullopt;
+		}
+		if (*len < 0) {
+			return fail(Error::INVALID_LENGTH, start);
+		}
+		const auto size = static_cast<size_t>(*len);
+		if (size > (data.size() - pos) / elementSize<T>()) {
+			return fail(Error::TRUNCATED, pos);
+		}
 
-			ByteArrayTag array{};
-			array.reserve(size);
-			for (size_t i = 0; i < size; ++i) {
-				if (auto v = readI8()) {
-					array.emplace_back(*v);
+		ArrayTag<T> array{ resource };
+		array.resize(size);
+		if constexpr (Format::varint && sizeof(T) > 1) {
+			for (auto& value : array) {
+				std::optional<T> v{};
+				if constexpr (sizeof(T) == 4) {
+					v = readI32();
 				} else {
+					v = readI64();
+				}
+				if (!v.has_value()) {
 					return std::nullopt;
 				}
+				value = *v;
 			}
-			return array;
+		} else {
+			copyEndian<Format::order, T>(array.data(), data.data() + pos, size);
+			pos += size * sizeof(T);
 		}
-		return std::nullopt;
+		return array;
 	}
 
-	template <>
-	std::optional<IntArrayTag> readTag() {
-		if (auto len = readI32()) {
-			const auto size = static_cast<size_t>(*len);
+	std::optional<ByteArrayTag> readTag(std::type_identity<ByteArrayTag>) {
+		return readArrayTag<int8_t>();
+	}
 
-			IntArrayTag array{};
-			array.reserve(size);
-			for (size_t i = 0; i < size; ++i) {
-				if (auto v = readI32()) {
-					array.emplace_back(*v);
-				} else {
-					return std::nullopt;
-				}
-			}
-			return array;
-		}
-		return std::nullopt;
+	std::optional<IntArrayTag> readTag(std::type_identity<IntArrayTag>) {
+		return readArrayTag<int32_t>();
 	}
 
-	template <>
-	std::optional<LongArrayTag> readTag() {
-		if (auto len = readI32()) {
-			const auto size = static_cast<size_t>(*len);
+	std::optional<LongArrayTag> readTag(std::type_identity<LongArrayTag>) {
+		return readArrayTag<int64_t>();
+	}
 
-			LongArrayTag array{};
-			array.reserve(size);
-			for (size_t i = 0; i < size; ++i) {
-				if (auto v = readI64()) {
-					array.emplace_back(*v);
-				} else {
-					return std::nullopt;
-				}
-			}
-			return array;
+	// Compounds and lists of compounds or lists are decoded without recursion: containers
+	// are created in place inside their parent and tracked on an explicit stack, at most
+	// `maxDepth` levels deep.
+	std::optional<CompoundTag> readTag(std::type_identity<CompoundTag>) {
+		CompoundTag compound{ resource };
+		if (!readTree(Frame{ ID::COMPOUND, ID::END, 0, &compound, nullptr })) {
+			return std::nullopt;
 		}
-		return std::nullopt;
+		return compound;
 	}
 
-	template <>
-	std::optional<CompoundTag> readTag() {
-		CompoundTag ct{};
-
-		auto emplace = [this]<typename T>(CompoundTag& ct, std::string name, std::optional<T>(NBTFile::*read)()) -> bool {
-			if (auto tag = (this->*read)()) {
-				ct.emplace(std::move(name), std::move(*tag));
-				return true;
-			}
-			return false;
-		};
+	std::optional<EndTag> readTag(std::type_identity<EndTag>) {
+		return EndTag{};
+	}
 
+	// Reads a compound payload, matching entry names against `keys` with a single lookup.
+	// Known keys are stored as interned names pointing at the KeySet's strings, so they
+	// cost no allocation; unknown keys are either read as usual or skipped.
+	template <size_t N>
+	std::optional<CompoundTag> readCompound(const KeySet<N>& keys, UnknownKeys unknown = UnknownKeys::READ) {
+		CompoundTag::storage_type entries{ resource };
 		while (true) {
 			auto id = readID();
 			if (!id.has_value()) {
 				return std::nullopt;
 			}
 			if (*id == ID::END) {
-				return ct;
+				return CompoundTag(std::move(entries));
 			}
-			auto name = readString();
+			auto name = readStringView();
 			if (!name.has_value()) {
 				return std::nullopt;
 			}
-			switch (*id) {
-				case ID::BYTE:
-					if (!emplace(ct, std::move(*name), &NBTFile::readTag<ByteTag>)) {
-						return std::nullopt;
-					}
-					break;
-				case ID::SHORT:
-					if (!emplace(ct, std::move(*name), &NBTFile::readTag<ShortTag>)) {
-						return std::nullopt;
-					}
-					break;
-				case ID::INT:
-					if (!emplace(ct, std::move(*name), &NBTFile::readTag<IntTag>)) {
-						return std::nullopt;
-					}
-					break;
-				case ID::LONG:
-					if (!emplace(ct, std::move(*name), &NBTFile::readTag<LongTag>)) {
-						return std::nullopt;
-					}
-					break;
-				case ID::FLOAT:
-					if (!emplace(ct, std::move(*name), &NBTFile::readTag<FloatTag>)) {
-						return std::nullopt;
-					}
-					break;
-				case ID::DOUBLE:
-					if (!emplace(ct, std::move(*name), &NBTFile::readTag<DoubleTag>)) {
-						return std::nullopt;
-					}
-					break;
-				case ID::BYTE_ARRAY:
-					if (!emplace(ct, std::move(*name), &NBTFile::readTag<ByteArrayTag>)) {
-						return std::nullopt;
-					}
-					break;
-				case ID::STRING:
-					if (!emplace(ct, std::move(*name), &NBTFile::readTag<StringTag>)) {
-						return std::nullopt;
-					}
-					break;
-				case ID::LIST: {
-					if (!emplace(ct, std::move(*name), &NBTFile::readTag<ListTag>)) {
-						return std::nullopt;
-					}
-				}
-				case ID::COMPOUND:
-					if (!emplace(ct, std::move(*name), &NBTFile::readTag<CompoundTag>)) {
-						return std::nullopt;
-					}
-					break;
-				case ID::INT_ARRAY:
-					if (!emplace(ct, std::move(*name), &NBTFile::readTag<IntArrayTag>)) {
-						return std::nullopt;
-					}
-					break;
-				case ID::LONG_ARRAY:
-					if (!emplace(ct, std::move(*name), &NBTFile::readTag<LongArrayTag>)) {
-						return std::nullopt;
-					}
-					break;
-				default:
+
+			const auto index = keys.find(*name);
+			if (!index.has_value() && unknown == UnknownKeys::SKIP) {
+				if (!skipTag(*id)) {
 					return std::nullopt;
+				}
+				continue;
 			}
+			auto tag = readPayload(*id);
+			if (!tag.has_value()) {
+				return std::nullopt;
+			}
+			entries.emplace_back(index.has_value() ? TagName::interned(keys[*index]) : makeName(*name), std::move(*tag));
 		}
 	}
 
-	template <>
-	std::optional<EndTag> readTag() {
-		return EndTag{};
+	std::optional<CompoundTag> read() {
+		return document([&] { return readTag<CompoundTag>(); });
 	}
 
-	std::optional<CompoundTag> read() {
-		if (readID().value_or(ID::END) != ID::COMPOUND) {
-			return std::nullopt;
-		}
+	std::optional<CompoundTag> read(std::span<const std::string_view> paths) {
+		return document([&] { return readFilteredTag(paths); });
+	}
 
-		auto name = readString();
-		if (!name.has_value()) {
-			return std::nullopt;
+	std::optional<CompoundTag> read(std::initializer_list<std::string_view> paths) {
+		return read(std::span(paths.begin(), paths.size()));
+	}
+
+	ParseResult<CompoundTag> parse() {
+		if (auto root = read()) {
+			return std::move(*root);
 		}
-		auto tag = readTag<CompoundTag>();
-		if (!tag.has_value()) {
-			return std::nullopt;
+		return failure.value_or(ParseError{ Error::TRUNCATED, pos });
+	}
+
+	// The first failure since this reader was created, if any.
+	std::optional<ParseError> error() const {
+		return failure;
+	}
+
+	template <size_t N>
+	std::optional<CompoundTag> read(const KeySet<N>& keys, UnknownKeys unknown = UnknownKeys::READ) {
+		return document([&] { return readCompound(keys, unknown); });
+	}
+
+#if defined(NBT_ENABLE_STATS)
+	// Counters of the last document read with read() or parse().
+	const NBTStats& stats() const {
+		return statistics;
+	}
+#endif
+
+private:
+	// Reads the root tag and name, then the root payload with `read`.
+	template <typename F>
+	std::optional<CompoundTag> document(F&& read) {
+#if defined(NBT_ENABLE_STATS)
+		statistics = NBTStats{};
+		const auto start = pos;
+		const auto counter = dynamic_cast<CountingResource*>(resource);
+		const auto allocations = counter != nullptr ? counter->allocations.load() : 0;
+		const auto bytes = counter != nullptr ? counter->bytes.load() : 0;
+		mark = NBTStats::Clock::now();
+		timing = ID::COMPOUND;
+#endif
+
+		std::optional<CompoundTag> ct{};
+		if (auto name = readRootName()) {
+			countTags(ID::COMPOUND);
+			if (auto tag = read()) {
+				ct.emplace(resource);
+				ct->emplace(*name, std::move(*tag));
+			}
 		}
 
-		CompoundTag ct{};
-		ct.emplace(std::move(*name), std::move(*tag));
+#if defined(NBT_ENABLE_STATS)
+		timeAs(ID::END);
+		statistics.bytes = pos - start;
+		statistics.ok = ct.has_value();
+		if (counter != nullptr) {
+			statistics.allocations = counter->allocations.load() - allocations;
+			statistics.allocatedBytes = counter->bytes.load() - bytes;
+		}
+		if (NBTStats::onDocument) {
+			NBTStats::onDocument(statistics);
+		}
+#endif
 		return ct;
 	}
 
-private:
-	std::span<const std::byte> data{};
-	size_t pos = 0;
+	// Instrumentation hooks; they compile to nothing unless NBT_ENABLE_STATS is defined.
+	void countTags([[maybe_unused]] ID id, [[maybe_unused]] size_t n = 1) {
+#if defined(NBT_ENABLE_STATS)
+		statistics.tags[static_cast<size_t>(id)] += n;
+#endif
+	}
+
+	// Charges the time since the last call to the type being timed, then starts timing
+	// `id`; returns the previous type so the caller can switch back.
+	ID timeAs(ID id) {
+#if defined(NBT_ENABLE_STATS)
+		const auto now = NBTStats::Clock::now();
+		statistics.time[static_cast<size_t>(timing)] += now - mark;
+		mark = now;
+		std::swap(timing, id);
+#endif
+		return id;
+	}
+
+	void reached([[maybe_unused]] size_t depth) {
+#if defined(NBT_ENABLE_STATS)
+		statistics.maxDepth = std::max(statistics.maxDepth, depth);
+#endif
+	}
+
+	std::nullopt_t fail(Error kind, size_t offset) {
+		if (!failure.has_value()) {
+			failure = ParseError{ kind, offset };
+		}
+		return std::nullopt;
+	}
+
+	static bool valid(ID id) {
+		return id >= ID::END && id <= ID::LONG_ARRAY;
+	}
+
+	template <typename T>
+	std::optional<T> readFixed() {
+		if (data.size() - pos < sizeof(T)) {
+			return fail(Error::TRUNCATED, pos);
+		}
+		const auto value = loadEndian<Format::order, T>(data.data() + pos);
+		pos += sizeof(T);
+		return value;
+	}
+
+	template <typename U>
+	std::optional<U> readVarUInt() {
+		const auto start = pos;
+		U value = 0;
+		for (unsigned shift = 0; shift < sizeof(U) * 8; shift += 7) {
+			if (pos >= data.size()) {
+				return fail(Error::TRUNCATED, start);
+			}
+			const auto byte = static_cast<uint8_t>(data[pos++]);
+			value |= static_cast<U>(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0) {
+				return value;
+			}
+		}
+		return fail(Error::INVALID_VARINT, start);
+	}
+
+	template <typename T>
+	std::optional<T> readVarint() {
+		using U = std::make_unsigned_t<T>;
+		if (auto value = readVarUInt<U>()) {
+			return static_cast<T>((*value >> 1) ^ (U(0) - (*value & 1)));
+		}
+		return std::nullopt;
+	}
+
+	template <typename V>
+	static V load(const std::byte* src) {
+		if constexpr (std::is_floating_point_v<V>) {
+			using I = std::conditional_t<sizeof(V) == 4, int32_t, int64_t>;
+			return std::bit_cast<V>(loadEndian<Format::order, I>(src));
+		} else {
+			return loadEndian<Format::order, V>(src);
+		}
+	}
+
+	// Scalar tags whose values all have the same encoded size.
+	template <typename T>
+	static constexpr bool isFixedScalar() {
+		if constexpr (std::is_same_v<T, IntTag> || std::is_same_v<T, LongTag>) {
+			return !Format::varint;
+		}
+		return std::is_same_v<T, ByteTag> || std::is_same_v<T, ShortTag> || std::is_same_v<T, FloatTag> || std::is_same_v<T, DoubleTag>;
+	}
+
+	std::optional<std::string_view> readRootName() {
+		const auto id = readID();
+		if (!id.has_value()) {
+			return std::nullopt;
+		}
+		if (*id != ID::COMPOUND) {
+			return fail(Error::INVALID_TYPE, pos - 1);
+		}
+		if constexpr (!Format::namedRoot) {
+			return std::string_view{};
+		}
+		return readStringView();
+	}
+
+	std::optional<Tag> readValue(ID id);
+
+	struct Frame {
+		ID kind;
+		ID element;
+		size_t remaining;
+		CompoundTag* compound;
+		ListTag* list;
+	};
+
+	// Most documents nest only a few levels, so the first frames live inline and skipping
+	// a small tag allocates nothing.
+	struct FrameStack {
+		size_t size() const {
+			return count;
+		}
+
+		Frame& back() {
+			return count > local.size() ? spill.back() : local[count - 1];
+		}
+
+		void push_back(const Frame& frame) {
+			if (count < local.size()) {
+				local[count] = frame;
+			} else {
+				spill.push_back(frame);
+			}
+			++count;
+		}
+
+		void pop_back() {
+			if (count > local.size()) {
+				spill.pop_back();
+			}
+			--count;
+		}
+
+		void resize(size_t size) {
+			spill.resize(std::max(size, local.size()) - local.size());
+			count = size;
+		}
+
+	private:
+		std::array<Frame, 16> local{};
+		std::vector<Frame> spill{};
+		size_t count = 0;
+	};
+
+	// Lists whose elements cannot contain other tags; these never need a stack frame.
+	std::optional<ListTag> readList(ID element) {
+		const auto outer = timeAs(element);
+		auto list = readListOf(element);
+		timeAs(outer);
+		if (list.has_value()) {
+			countTags(element, list->size());
+		}
+		return list;
+	}
+
+	std::optional<ListTag> readListOf(ID element) {
+		switch (element) {
+			case ID::END:
+				return readListTag<EndTag>();
+			case ID::BYTE:
+				return readListTag<ByteTag>();
+			case ID::SHORT:
+				return readListTag<ShortTag>();
+			case ID::INT:
+				return readListTag<IntTag>();
+			case ID::LONG:
+				return readListTag<LongTag>();
+			case ID::FLOAT:
+				return readListTag<FloatTag>();
+			case ID::DOUBLE:
+				return readListTag<DoubleTag>();
+			case ID::BYTE_ARRAY:
+				return readListTag<ByteArrayTag>();
+			case ID::STRING:
+				return readListTag<StringTag>();
+			case ID::INT_ARRAY:
+				return readListTag<IntArrayTag>();
+			case ID::LONG_ARRAY:
+				return readListTag<LongArrayTag>();
+			default:
+				return fail(Error::INVALID_TYPE, pos - 1);
+		}
+	}
+
+	// Reads the length of a list of lists or compounds and reserves room for its elements.
+	std::optional<size_t> beginList(ListTag& list, ID element) {
+		const auto start = pos;
+		const auto len = readI32();
+		if (!len.has_value()) {
+			return std::nullopt;
+		}
+		if (*len < 0) {
+			return fail(Error::INVALID_LENGTH, start);
+		}
+		const auto count = static_cast<size_t>(*len);
+		if (count > (data.size() - pos) / (element == ID::LIST ? minimumSize<ListTag>() : minimumSize<CompoundTag>())) {
+			return fail(Error::TRUNCATED, pos);
+		}
+		list.reserve(count);
+		return count;
+	}
+
+	bool readTree(Frame root) {
+		const auto base = frames.size();
+		ID outer = ID::END;
+		const auto unwind = [&] {
+			frames.resize(base);
+			timeAs(outer);
+			return false;
+		};
+		if (maxDepth == 0) {
+			fail(Error::DEPTH_LIMIT, pos);
+			return false;
+		}
+		frames.push_back(root);
+		reached(frames.size());
+		outer = timeAs(root.kind);
+
+		while (frames.size() > base) {
+			auto& top = frames.back();
+			ID id = top.element;
+			CompoundTag* compound = top.compound;
+			ListTag* list = top.list;
+
+			std::string_view name{};
+			if (top.kind == ID::COMPOUND) {
+				const auto entry = readID();
+				if (!entry.has_value()) {
+					return unwind();
+				}
+				if (*entry == ID::END) {
+					frames.pop_back();
+					compound->normalize();
+					timeAs(frames.size() > base ? frames.back().kind : outer);
+					continue;
+				}
+				if (!valid(*entry)) {
+					fail(Error::INVALID_TYPE, pos - 1);
+					return unwind();
+				}
+				const auto key = readStringView();
+				if (!key.has_value()) {
+					return unwind();
+				}
+				id = *entry;
+				name = *key;
+			} else {
+				if (top.remaining == 0) {
+					frames.pop_back();
+					timeAs(frames.size() > base ? frames.back().kind : outer);
+					continue;
+				}
+				--top.remaining;
+			}
+
+			// Appends `tag` to the open container and returns where it was stored.
+			const auto append = [&]<typename T>(T&& tag) -> Tag& {
+				if (compound != nullptr) {
+					return compound->value.emplace_back(makeName(name), std::forward<T>(tag)).second;
+				}
+				list->emplace_back(std::forward<T>(tag));
+				return (*list)[list->size() - 1];
+			};
+
+			if (id == ID::COMPOUND) {
+				if (frames.size() - base >= maxDepth) {
+					fail(Error::DEPTH_LIMIT, pos);
+					return unwind();
+				}
+				auto& child = std::get<CompoundTag>(append(CompoundTag{ resource }));
+				frames.push_back(Frame{ ID::COMPOUND, ID::END, 0, &child, nullptr });
+				countTags(ID::COMPOUND);
+				reached(frames.size());
+				timeAs(ID::COMPOUND);
+			} else if (id == ID::LIST) {
+				const auto element = readID();
+				if (!element.has_value()) {
+					return unwind();
+				}
+				if (*element != ID::LIST && *element != ID::COMPOUND) {
+					auto tag = readList(*element);
+					if (!tag.has_value()) {
+						return unwind();
+					}
+					countTags(ID::LIST);
+					append(std::move(*tag));
+					continue;
+				}
+				if (frames.size() - base >= maxDepth) {
+					fail(Error::DEPTH_LIMIT, pos);
+					return unwind();
+				}
+				auto& child = std::get<ListTag>(append(ListTag{ resource }));
+				const auto count = beginList(child, *element);
+				if (!count.has_value()) {
+					return unwind();
+				}
+				frames.push_back(Frame{ ID::LIST, *element, *count, nullptr, &child });
+				countTags(ID::LIST);
+				reached(frames.size());
+				timeAs(ID::LIST);
+			} else {
+				auto tag = readPayload(id);
+				if (!tag.has_value()) {
+					return unwind();
+				}
+				append(std::move(*tag));
+			}
+		}
+		return true;
+	}
+
+	TagName makeName(std::string_view name) {
+		if (names != nullptr) {
+			if (auto interned = names->intern(name)) {
+				return TagName::interned(*interned);
+			}
+		}
+		return TagName(name, resource);
+	}
+
+	template <typename T>
+	static constexpr size_t minimumSize() {
+		constexpr size_t length = Format::varint ? 1 : 4;
+		if constexpr (std::is_same_v<T, StringTag>) {
+			return Format::varint ? 1 : 2;
+		} else if constexpr (std::is_same_v<T, ListTag>) {
+			return 1 + length;
+		} else if constexpr (std::is_same_v<T, CompoundTag>) {
+			return 1;
+		} else if constexpr (std::is_same_v<T, ByteArrayTag> || std::is_same_v<T, IntArrayTag> || std::is_same_v<T, LongArrayTag>) {
+			return length;
+		} else if constexpr (std::is_same_v<T, IntTag> || std::is_same_v<T, LongTag>) {
+			return Format::varint ? 1 : sizeof(T::value);
+		} else {
+			return sizeof(T::value);
+		}
+	}
+
+	// Smallest encoding of one element of an array tag.
+	template <typename T>
+	static constexpr size_t elementSize() {
+		return Format::varint ? 1 : sizeof(T);
+	}
+
+	template <typename T>
+	bool skipArray() {
+		const auto start = pos;
+		const auto len = readI32();
+		if (!len.has_value()) {
+			return false;
+		}
+		if (*len < 0) {
+			fail(Error::INVALID_LENGTH, start);
+			return false;
+		}
+		const auto count = static_cast<size_t>(*len);
+		if (count > (data.size() - pos) / elementSize<T>()) {
+			fail(Error::TRUNCATED, pos);
+			return false;
+		}
+		if constexpr (Format::varint && sizeof(T) > 1) {
+			for (size_t i = 0; i < count; ++i) {
+				if (!readVarUInt<std::make_unsigned_t<T>>().has_value()) {
+					return false;
+				}
+			}
+		} else {
+			pos += count * sizeof(T);
+		}
+		return true;
+	}
+
+	std::optional<CompoundTag> readFilteredTag(std::span<const std::string_view> paths) {
+		CompoundTag ct{ resource };
+		std::vector<std::string_view> nested{};
+
+		while (true) {
+			auto id = readID();
+			if (!id.has_value()) {
+				return std::nullopt;
+			}
+			if (*id == ID::END) {
+				return ct;
+			}
+			auto name = readStringView();
+			if (!name.has_value()) {
+				return std::nullopt;
+			}
+
+			bool whole = false;
+			nested.clear();
+			for (auto path : paths) {
+				if (path == *name) {
+					whole = true;
+				} else if (path.size() > name->size() && path.starts_with(*name) && path[name->size()] == '.') {
+					nested.push_back(path.substr(name->size() + 1));
+				}
+			}
+
+			if (whole) {
+				auto tag = readPayload(*id);
+				if (!tag.has_value()) {
+					return std::nullopt;
+				}
+				ct.emplace(*name, std::move(*tag));
+			} else if (!nested.empty() && *id == ID::COMPOUND) {
+				auto tag = readFilteredTag(std::vector<std::string_view>(nested));
+				if (!tag.has_value()) {
+					return std::nullopt;
+				}
+				ct.emplace(*name, std::move(*tag));
+			} else if (!skipTag(*id)) {
+				return std::nullopt;
+			}
+		}
+	}
+
+	std::span<const std::byte> data{};
+	size_t pos = 0;
+	std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+	NameInterner* names = nullptr;
+	size_t maxDepth = MAX_DEPTH;
+	FrameStack frames{};
+	std::optional<ParseError> failure{};
+#if defined(NBT_ENABLE_STATS)
+	NBTStats statistics{};
+	ID timing = ID::END;
+	NBTStats::Clock::time_point mark = NBTStats::Clock::now();
+#endif
+};
+
+template <typename Format>
+inline std::optional<Tag> BasicNBTFile<Format>::readPayload(ID id) {
+#if defined(NBT_ENABLE_STATS)
+	countTags(id);
+	if (id != ID::LIST && id != ID::COMPOUND) {
+		const auto outer = timeAs(id);
+		auto tag = readValue(id);
+		timeAs(outer);
+		return tag;
+	}
+#endif
+	return readValue(id);
+}
+
+template <typename Format>
+inline std::optional<Tag> BasicNBTFile<Format>::readValue(ID id) {
+	switch (id) {
+		case ID::END:
+			return readTag<EndTag>();
+		case ID::BYTE:
+			return readTag<ByteTag>();
+		case ID::SHORT:
+			return readTag<ShortTag>();
+		case ID::INT:
+			return readTag<IntTag>();
+		case ID::LONG:
+			return readTag<LongTag>();
+		case ID::FLOAT:
+			return readTag<FloatTag>();
+		case ID::DOUBLE:
+			return readTag<DoubleTag>();
+		case ID::BYTE_ARRAY:
+			return readTag<ByteArrayTag>();
+		case ID::STRING:
+			return readTag<StringTag>();
+		case ID::LIST:
+			return readTag<ListTag>();
+		case ID::COMPOUND:
+			return readTag<CompoundTag>();
+		case ID::INT_ARRAY:
+			return readTag<IntArrayTag>();
+		case ID::LONG_ARRAY:
+			return readTag<LongArrayTag>();
+		default:
+			return fail(Error::INVALID_TYPE, pos);
+	}
+}
+
+using NBTFile = BasicNBTFile<JavaFormat>;
+using JavaNetworkNBTFile = BasicNBTFile<JavaNetworkFormat>;
+using BedrockNBTFile = BasicNBTFile<BedrockFormat>;
+using BedrockNetworkNBTFile = BasicNBTFile<BedrockNetworkFormat>;
+
+template <typename T>
+struct ArrayView {
+	struct iterator {
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+
+		T operator*() const {
+			return loadBigEndian<T>(ptr);
+		}
+
+		iterator& operator++() {
+			ptr += sizeof(T);
+			return *this;
+		}
+
+		iterator operator++(int) {
+			auto it = *this;
+			ptr += sizeof(T);
+			return it;
+		}
+
+		bool operator==(const iterator&) const = default;
+
+		const std::byte* ptr = nullptr;
+	};
+
+	ArrayView() = default;
+	ArrayView(const std::byte* bytes, size_t count) : bytes(bytes), count(count) {}
+
+	size_t size() const {
+		return count;
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+
+	T operator[](size_t i) const {
+		return loadBigEndian<T>(bytes + i * sizeof(T));
+	}
+
+	T at(size_t i) const {
+		if (i >= count) {
+			throw std::out_of_range("ArrayView::at");
+		}
+		return (*this)[i];
+	}
+
+	iterator begin() const {
+		return iterator{ bytes };
+	}
+
+	iterator end() const {
+		return iterator{ bytes + count * sizeof(T) };
+	}
+
+	void copyTo(std::span<T> out) const {
+		copyBigEndian<T>(out.data(), bytes, std::min(out.size(), count));
+	}
+
+	ArrayTag<T> value(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const {
+		ArrayTag<T> array{ resource };
+		array.resize(count);
+		copyBigEndian<T>(array.data(), bytes, count);
+		return array;
+	}
+
+	std::span<const std::byte> raw() const {
+		return { bytes, count * sizeof(T) };
+	}
+
+private:
+	const std::byte* bytes = nullptr;
+	size_t count = 0;
+};
+
+struct ListView;
+struct CompoundView;
+
+struct TagView {
+	using ID = NBTFile::ID;
+
+	TagView() = default;
+	TagView(ID id, std::span<const std::byte> payload) : tag(id), bytes(payload) {}
+
+	ID id() const {
+		return tag;
+	}
+
+	std::span<const std::byte> payload() const {
+		return bytes;
+	}
+
+	std::optional<int8_t> asByte() const {
+		return scalar<int8_t>(ID::BYTE);
+	}
+
+	std::optional<int16_t> asShort() const {
+		return scalar<int16_t>(ID::SHORT);
+	}
+
+	std::optional<int32_t> asInt() const {
+		return scalar<int32_t>(ID::INT);
+	}
+
+	std::optional<int64_t> asLong() const {
+		return scalar<int64_t>(ID::LONG);
+	}
+
+	std::optional<float> asFloat() const {
+		if (auto i32 = scalar<int32_t>(ID::FLOAT)) {
+			return std::bit_cast<float>(*i32);
+		}
+		return std::nullopt;
+	}
+
+	std::optional<double> asDouble() const {
+		if (auto i64 = scalar<int64_t>(ID::DOUBLE)) {
+			return std::bit_cast<double>(*i64);
+		}
+		return std::nullopt;
+	}
+
+	std::optional<std::string_view> asString() const {
+		if (tag != ID::STRING || bytes.size() < 2) {
+			return std::nullopt;
+		}
+		return std::string_view(reinterpret_cast<const char*>(bytes.data()) + 2, bytes.size() - 2);
+	}
+
+	std::optional<ArrayView<int8_t>> asByteArray() const {
+		return array<int8_t>(ID::BYTE_ARRAY);
+	}
+
+	std::optional<ArrayView<int32_t>> asIntArray() const {
+		return array<int32_t>(ID::INT_ARRAY);
+	}
+
+	std::optional<ArrayView<int64_t>> asLongArray() const {
+		return array<int64_t>(ID::LONG_ARRAY);
+	}
+
+	std::optional<ListView> asList() const;
+	std::optional<CompoundView> asCompound() const;
+	std::optional<Tag> materialize(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+	static std::optional<size_t> measure(ID id, std::span<const std::byte> data) {
+		NBTFile file(data);
+		if (!file.skipTag(id)) {
+			return std::nullopt;
+		}
+		return file.position();
+	}
+
+private:
+	template <typename T>
+	std::optional<T> scalar(ID expected) const {
+		if (tag != expected || bytes.size() < sizeof(T)) {
+			return std::nullopt;
+		}
+		return loadBigEndian<T>(bytes.data());
+	}
+
+	template <typename T>
+	std::optional<ArrayView<T>> array(ID expected) const {
+		if (tag != expected || bytes.size() < 4) {
+			return std::nullopt;
+		}
+		return ArrayView<T>(bytes.data() + 4, (bytes.size() - 4) / sizeof(T));
+	}
+
+	ID tag = ID::END;
+	std::span<const std::byte> bytes{};
+};
+
+struct ListView {
+	using ID = NBTFile::ID;
+
+	struct iterator {
+		using value_type = TagView;
+		using difference_type = std::ptrdiff_t;
+
+		const TagView& operator*() const {
+			return current;
+		}
+
+		const TagView* operator->() const {
+			return &current;
+		}
+
+		iterator& operator++() {
+			offset += current.payload().size();
+			load();
+			return *this;
+		}
+
+		iterator operator++(int) {
+			auto it = *this;
+			++*this;
+			return it;
+		}
+
+		bool operator==(const iterator& other) const {
+			return offset == other.offset;
+		}
+
+		// A malformed element ends the iteration.
+		void load() {
+			if (offset < list->bytes.size()) {
+				const auto rest = list->bytes.subspan(offset);
+				const auto size = TagView::measure(list->element, rest);
+				if (!size.has_value() || *size == 0) {
+					offset = list->bytes.size();
+					return;
+				}
+				current = TagView(list->element, rest.first(*size));
+			}
+		}
+
+		const ListView* list = nullptr;
+		size_t offset = 0;
+		TagView current{};
+	};
+
+	ListView() = default;
+	ListView(ID element, size_t count, std::span<const std::byte> elements) : element(element), count(count), bytes(elements) {}
+
+	ID elementType() const {
+		return element;
+	}
+
+	size_t size() const {
+		return count;
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+
+	iterator begin() const {
+		iterator it{ this, 0 };
+		it.load();
+		return it;
+	}
+
+	iterator end() const {
+		return iterator{ this, bytes.size() };
+	}
+
+private:
+	ID element = ID::END;
+	size_t count = 0;
+	std::span<const std::byte> bytes{};
+};
+
+struct CompoundView {
+	using ID = NBTFile::ID;
+
+	struct iterator {
+		using value_type = std::pair<std::string_view, TagView>;
+		using difference_type = std::ptrdiff_t;
+
+		const value_type& operator*() const {
+			return current;
+		}
+
+		const value_type* operator->() const {
+			return &current;
+		}
+
+		iterator& operator++() {
+			offset = next;
+			load();
+			return *this;
+		}
+
+		iterator operator++(int) {
+			auto it = *this;
+			++*this;
+			return it;
+		}
+
+		bool operator==(const iterator& other) const {
+			return offset == other.offset;
+		}
+
+		// The END tag, the end of the payload or a malformed entry ends the iteration.
+		void load() {
+			const auto bytes = compound->bytes;
+			if (bytes.size() - offset < 3 || static_cast<ID>(bytes[offset]) == ID::END) {
+				offset = bytes.size();
+				return;
+			}
+			const auto id = static_cast<ID>(bytes[offset]);
+			const size_t length = loadBigEndian<uint16_t>(bytes.data() + offset + 1);
+			if (bytes.size() - offset - 3 < length) {
+				offset = bytes.size();
+				return;
+			}
+			const auto payload = bytes.subspan(offset + 3 + length);
+			const auto size = TagView::measure(id, payload);
+			if (!size.has_value()) {
+				offset = bytes.size();
+				return;
+			}
+
+			current.first = std::string_view(reinterpret_cast<const char*>(bytes.data()) + offset + 3, length);
+			current.second = TagView(id, payload.first(*size));
+			next = offset + 3 + length + *size;
+		}
+
+		const CompoundView* compound = nullptr;
+		size_t offset = 0;
+		size_t next = 0;
+		value_type current{};
+	};
+
+	CompoundView() = default;
+	explicit CompoundView(std::span<const std::byte> payload) : bytes(payload) {}
+
+	iterator begin() const {
+		iterator it{ this, 0 };
+		it.load();
+		return it;
+	}
+
+	iterator end() const {
+		return iterator{ this, bytes.size() };
+	}
+
+	size_t size() const {
+		size_t count = 0;
+		for (auto it = begin(); it != end(); ++it) {
+			++count;
+		}
+		return count;
+	}
+
+	std::optional<TagView> find(std::string_view name) const {
+		for (const auto& [key, tag] : *this) {
+			if (key == name) {
+				return tag;
+			}
+		}
+		return std::nullopt;
+	}
+
+	bool contains(std::string_view name) const {
+		return find(name).has_value();
+	}
+
+	std::span<const std::byte> payload() const {
+		return bytes;
+	}
+
+private:
+	std::span<const std::byte> bytes{};
+};
+
+inline std::optional<ListView> TagView::asList() const {
+	if (tag != ID::LIST || bytes.size() < 5) {
+		return std::nullopt;
+	}
+	const auto element = static_cast<ID>(bytes[0]);
+	const auto count = loadBigEndian<int32_t>(bytes.data() + 1);
+	return ListView(element, static_cast<size_t>(count), bytes.subspan(5));
+}
+
+inline std::optional<CompoundView> TagView::asCompound() const {
+	if (tag != ID::COMPOUND) {
+		return std::nullopt;
+	}
+	return CompoundView(bytes);
+}
+
+inline std::optional<Tag> TagView::materialize(std::pmr::memory_resource* resource) const {
+	return NBTFile(bytes, resource).readPayload(tag);
+}
+
+struct NBTView {
+	using ID = NBTFile::ID;
+
+	explicit NBTView(std::span<const std::byte> data) : data(data) {}
+
+	std::string_view name() const {
+		return root;
+	}
+
+	std::optional<CompoundView> read() {
+		if (data.empty() || static_cast<ID>(data[0]) != ID::COMPOUND) {
+			return std::nullopt;
+		}
+		const auto rest = data.subspan(1);
+		const auto length = TagView::measure(ID::STRING, rest);
+		if (!length.has_value()) {
+			return std::nullopt;
+		}
+		const auto payload = rest.subspan(*length);
+		const auto size = TagView::measure(ID::COMPOUND, payload);
+		if (!size.has_value()) {
+			return std::nullopt;
+		}
+		root = std::string_view(reinterpret_cast<const char*>(rest.data()) + 2, *length - 2);
+		return CompoundView(payload.first(*size));
+	}
+
+private:
+	std::span<const std::byte> data{};
+	std::string_view root{};
+};
+
+template <typename Format>
+struct BasicNBTWriter {
+	using ID = TagID;
+
+	explicit BasicNBTWriter(std::vector<std::byte>& out) : out(out) {}
+
+	static ID idOf(const Tag& tag) {
+		static constexpr std::array<ID, std::variant_size_v<Tag::variant>> ids{
+			ID::END,
+			ID::BYTE,
+			ID::SHORT,
+			ID::INT,
+			ID::LONG,
+			ID::FLOAT,
+			ID::DOUBLE,
+			ID::STRING,
+			ID::BYTE_ARRAY,
+			ID::INT_ARRAY,
+			ID::LONG_ARRAY,
+			ID::LIST,
+			ID::COMPOUND,
+		};
+		return ids[tag.index()];
+	}
+
+	static std::optional<size_t> encodedSize(const Tag& tag) {
+		return std::visit([]<typename T>(const T& value) { return encodedSize(value); }, static_cast<const Tag::variant&>(tag));
+	}
+
+	// END only marks the end of a compound and has no encoding as a value, neither in a
+	// compound, where it would end it early, nor as the element of a non-empty list.
+	static std::optional<size_t> encodedSize(const EndTag&) {
+		return std::nullopt;
+	}
+
+	template <typename T> requires std::is_arithmetic_v<decltype(T::value)>
+	static std::optional<size_t> encodedSize(const T& tag) {
+		if constexpr (Format::varint && std::is_integral_v<decltype(T::value)> && sizeof(T::value) >= 4) {
+			return varintSize(zigzag(tag.value));
+		} else {
+			return sizeof(T::value);
+		}
+	}
+
+	static std::optional<size_t> encodedSize(const StringTag& tag) {
+		return encodedSize(std::string_view(tag.value));
+	}
+
+	template <typename T>
+	static std::optional<size_t> encodedSize(const ArrayTag<T>& tag) {
+		if (tag.size() > static_cast<size_t>(INT32_MAX)) {
+			return std::nullopt;
+		}
+		if constexpr (Format::varint && sizeof(T) > 1) {
+			size_t size = lengthSize(tag.size());
+			for (auto value : tag) {
+				size += varintSize(zigzag(value));
+			}
+			return size;
+		} else {
+			return lengthSize(tag.size()) + tag.size() * sizeof(T);
+		}
+	}
+
+	static std::optional<size_t> encodedSize(const ListTag& tag) {
+		if (tag.size() > static_cast<size_t>(INT32_MAX)) {
+			return std::nullopt;
+		}
+		size_t size = 1 + lengthSize(tag.size());
+		for (const auto& element : tag) {
+			if (idOf(element) != idOf(*tag.begin())) {
+				return std::nullopt;
+			}
+			auto element_size = encodedSize(element);
+			if (!element_size.has_value()) {
+				return std::nullopt;
+			}
+			size += *element_size;
+		}
+		return size;
+	}
+
+	static std::optional<size_t> encodedSize(const CompoundTag& tag) {
+		size_t size = 1;
+		for (const auto& [name, value] : tag) {
+			auto name_size = encodedSize(std::string_view(name));
+			auto value_size = encodedSize(value);
+			if (!name_size.has_value() || !value_size.has_value()) {
+				return std::nullopt;
+			}
+			size += 1 + *name_size + *value_size;
+		}
+		return size;
+	}
+
+	static std::optional<size_t> encodedSize(std::string_view str) {
+		if constexpr (Format::varint) {
+			if (str.size() > static_cast<size_t>(INT32_MAX)) {
+				return std::nullopt;
+			}
+			return varintSize(str.size()) + str.size();
+		} else {
+			if (str.size() > UINT16_MAX) {
+				return std::nullopt;
+			}
+			return 2 + str.size();
+		}
+	}
+
+	bool write(const CompoundTag& file) {
+		if (file.size() != 1) {
+			return false;
+		}
+		const auto& [name, tag] = *file.begin();
+		if (idOf(tag) != ID::COMPOUND) {
+			return false;
+		}
+		return write(name, std::get<CompoundTag>(tag));
+	}
+
+	// `name` is not written in formats with an unnamed root.
+	bool write(std::string_view name, const CompoundTag& root) {
+		auto name_size = Format::namedRoot ? encodedSize(name) : std::optional<size_t>(0);
+		auto root_size = encodedSize(root);
+		if (!name_size.has_value() || !root_size.has_value()) {
+			return false;
+		}
+
+		const auto start = out.size();
+		out.resize(start + 1 + *name_size + *root_size);
+		cursor = out.data() + start;
+
+		writeID(ID::COMPOUND);
+		if constexpr (Format::namedRoot) {
+			writeString(name);
+		}
+		writeTag(root);
+		return true;
+	}
+
+	// Appends one named tag as it is stored inside a compound: its type, name and payload.
+	bool writeEntry(std::string_view name, const Tag& tag) {
+		auto name_size = encodedSize(name);
+		auto tag_size = encodedSize(tag);
+		if (!name_size.has_value() || !tag_size.has_value()) {
+			return false;
+		}
+
+		const auto start = out.size();
+		out.resize(start + 1 + *name_size + *tag_size);
+		cursor = out.data() + start;
+
+		writeID(idOf(tag));
+		writeString(name);
+		writeTag(tag);
+		return true;
+	}
+
+private:
+	static uint64_t zigzag(int64_t value) {
+		return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+	}
+
+	static size_t varintSize(uint64_t value) {
+		size_t size = 1;
+		while (value >= 0x80) {
+			value >>= 7;
+			++size;
+		}
+		return size;
+	}
+
+	static size_t lengthSize(size_t length) {
+		return Format::varint ? varintSize(zigzag(static_cast<int64_t>(length))) : 4;
+	}
+
+	template <typename T>
+	void writeValue(T value) {
+		if constexpr (std::is_floating_point_v<T>) {
+			using I = std::conditional_t<sizeof(T) == 4, int32_t, int64_t>;
+			storeEndian<Format::order>(cursor, std::bit_cast<I>(value));
+		} else if constexpr (Format::varint && std::is_integral_v<T> && sizeof(T) >= 4) {
+			writeVarUInt(zigzag(value));
+			return;
+		} else {
+			storeEndian<Format::order>(cursor, value);
+		}
+		cursor += sizeof(T);
+	}
+
+	void writeVarUInt(uint64_t value) {
+		while (value >= 0x80) {
+			*cursor++ = static_cast<std::byte>(value | 0x80);
+			value >>= 7;
+		}
+		*cursor++ = static_cast<std::byte>(value);
+	}
+
+	void writeID(ID id) {
+		writeValue(static_cast<int8_t>(id));
+	}
+
+	void writeLength(size_t length) {
+		writeValue(static_cast<int32_t>(length));
+	}
+
+	void writeString(std::string_view str) {
+		if constexpr (Format::varint) {
+			writeVarUInt(str.size());
+		} else {
+			writeValue(static_cast<uint16_t>(str.size()));
+		}
+		std::memcpy(cursor, str.data(), str.size());
+		cursor += str.size();
+	}
+
+	void writeTag(const Tag& tag) {
+		std::visit([this]<typename T>(const T& value) { writeTag(value); }, static_cast<const Tag::variant&>(tag));
+	}
+
+	void writeTag(const EndTag&) {}
+
+	template <typename T> requires std::is_arithmetic_v<decltype(T::value)>
+	void writeTag(const T& tag) {
+		writeValue(tag.value);
+	}
+
+	void writeTag(const StringTag& tag) {
+		writeString(tag.value);
+	}
+
+	template <typename T>
+	void writeTag(const ArrayTag<T>& tag) {
+		writeLength(tag.size());
+		if constexpr (Format::varint && sizeof(T) > 1) {
+			for (auto value : tag) {
+				writeValue(value);
+			}
+		} else {
+			copyEndian<Format::order, T>(cursor, tag.data(), tag.size());
+			cursor += tag.size() * sizeof(T);
+		}
+	}
+
+	void writeTag(const ListTag& tag) {
+		writeID(tag.size() != 0 ? idOf(*tag.begin()) : ID::END);
+		writeLength(tag.size());
+		for (const auto& element : tag) {
+			writeTag(element);
+		}
+	}
+
+	void writeTag(const CompoundTag& tag) {
+		for (const auto& [name, value] : tag) {
+			writeID(idOf(value));
+			writeString(name);
+			writeTag(value);
+		}
+		writeID(ID::END);
+	}
+
+	std::vector<std::byte>& out;
+	std::byte* cursor = nullptr;
+};
+
+using NBTWriter = BasicNBTWriter<JavaFormat>;
+using JavaNetworkNBTWriter = BasicNBTWriter<JavaNetworkFormat>;
+using BedrockNBTWriter = BasicNBTWriter<BedrockFormat>;
+using BedrockNetworkNBTWriter = BasicNBTWriter<BedrockNetworkFormat>;
+
+// Reusable context for decoding many small documents, such as NBT from network packets.
+// Trees are allocated from an arena that is recycled by reset(); after a batch that
+// outgrew it, the arena's buffer is enlarged, so steady-state decoding makes no
+// allocations beyond the arena. Key names go through the decoder's own NameInterner, which
+// reset() clears. Trees returned by decode() and decodeBatch() are valid until the next
+// reset(); copies of them own their names and outlive it.
+struct NBTDecoder {
+	explicit NBTDecoder(size_t capacity = 64 * 1024, std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+		: overflow(upstream), buffer(std::max<size_t>(capacity, 1024)), arena(std::in_place, buffer.data(), buffer.size(), &overflow) {}
+
+	NBTDecoder(const NBTDecoder&) = delete;
+	NBTDecoder& operator=(const NBTDecoder&) = delete;
+
+	std::pmr::memory_resource* resource() {
+		return &*arena;
+	}
+
+	NameInterner& interner() {
+		return names;
+	}
+
+	std::optional<CompoundTag> decode(std::span<const std::byte> data) {
+		file.reset(data);
+		return file.read();
+	}
+
+	// Resets the decoder and decodes every payload; an entry is empty if its payload is
+	// malformed.
+	std::span<std::optional<CompoundTag>> decodeBatch(std::span<const std::span<const std::byte>> payloads) {
+		reset();
+		results.reserve(payloads.size());
+		for (auto payload : payloads) {
+			results.push_back(decode(payload));
+		}
+		return results;
+	}
+
+	void reset() {
+		results.clear();
+		names.clear();
+		arena.reset();
+		if (overflow.requested != 0) {
+			buffer = std::vector<std::byte>(buffer.size() + overflow.requested);
+			overflow.requested = 0;
+		}
+		arena.emplace(buffer.data(), buffer.size(), &overflow);
+	}
+
+private:
+	// Upstream of the arena; counts what did not fit into the buffer.
+	struct Overflow final : std::pmr::memory_resource {
+		explicit Overflow(std::pmr::memory_resource* parent) : parent(parent) {}
+
+		void* do_allocate(size_t bytes, size_t alignment) override {
+			requested += bytes;
+			return parent->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+			parent->deallocate(p, bytes, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+			return this == &other;
+		}
+
+		std::pmr::memory_resource* parent;
+		size_t requested = 0;
+	};
+
+	Overflow overflow;
+	std::vector<std::byte> buffer;
+	std::optional<std::pmr::monotonic_buffer_resource> arena;
+	NameInterner names{};
+	NBTFile file{ {}, &*arena, &names };
+	std::vector<std::optional<CompoundTag>> results{};
 };
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "nbt.hpp"
+
+// Palette indices bit-packed into a LONG_ARRAY, as in chunk section block states and
+// biomes. Each index takes `bits` bits, lowest bits of the first long first. Before 1.16
+// an index could span two longs; since 1.16 every long holds floor(64 / bits) indices and
+// the leftover high bits are padding. Indices are up to 16 bits wide; with 0 bits (a single
+// entry palette, stored without data) every index is 0.
+//
+// The kernels are instantiated per width, so every shift and mask is a constant and the
+// inner loops unroll and vectorize. Input can be a LongArrayTag, or an ArrayView over the
+// raw big-endian payload of a view, which is byte-swapped as it is read.
+struct PackedIndices {
+	enum class Layout {
+		SPANNING,
+		PADDED,
+	};
+
+	// Smallest width that can index a palette of `size` entries; block states use at least
+	// 4 bits, biomes at least 1.
+	static unsigned bitsFor(size_t size, unsigned minimum = 1) {
+		return std::max(minimum, static_cast<unsigned>(std::bit_width(std::max<size_t>(size, 1) - 1)));
+	}
+
+	// Number of longs needed for `count` indices of `bits` bits.
+	static size_t length(size_t count, unsigned bits, Layout layout) {
+		if (bits == 0) {
+			return 0;
+		}
+		if (layout == Layout::SPANNING) {
+			return (count * bits + 63) / 64;
+		}
+		const size_t per_long = 64 / bits;
+		return (count + per_long - 1) / per_long;
+	}
+
+	// Unpacks `out.size()` indices, usually 4096 for block states or 64 for biomes. Returns
+	// false if `bits` is above 16 or the array is too short for the layout.
+	static bool unpack(const LongArrayTag& data, unsigned bits, Layout layout, std::span<uint16_t> out) {
+		return unpackWords(std::span<const int64_t>(data.data(), data.size()), data.size(), bits, layout, out);
+	}
+
+	static bool unpack(ArrayView<int64_t> data, unsigned bits, Layout layout, std::span<uint16_t> out) {
+		return unpackWords(data, data.size(), bits, layout, out);
+	}
+
+	// Packs `indices` into `out`, resized to length(); bits above `bits` are dropped.
+	static bool pack(std::span<const uint16_t> indices, unsigned bits, Layout layout, LongArrayTag& out) {
+		if (bits > 16) {
+			return false;
+		}
+		out.resize(length(indices.size(), bits, layout));
+		if (bits == 0) {
+			return true;
+		}
+		const std::span<uint64_t> words(reinterpret_cast<uint64_t*>(out.data()), out.size());
+		withBits(bits, [&]<unsigned Bits>(std::integral_constant<unsigned, Bits>) {
+			if (layout == Layout::PADDED || 64 % Bits == 0) {
+				packPadded<Bits>(indices, words);
+			} else {
+				packSpanning<Bits>(indices, words);
+			}
+		});
+		return true;
+	}
+
+private:
+	template <typename Words>
+	static uint64_t word(const Words& words, size_t i) {
+		return static_cast<uint64_t>(words[i]);
+	}
+
+	// Calls `f` with std::integral_constant<unsigned, bits> for bits in [1, 16].
+	template <typename F>
+	static void withBits(unsigned bits, F&& f) {
+		[&]<unsigned... I>(std::integer_sequence<unsigned, I...>) {
+			((bits == I + 1 ? (f(std::integral_constant<unsigned, I + 1>{}), true) : false) || ...);
+		}(std::make_integer_sequence<unsigned, 16>{});
+	}
+
+	template <typename Words>
+	static bool unpackWords(const Words& words, size_t size, unsigned bits, Layout layout, std::span<uint16_t> out) {
+		if (bits > 16 || size < length(out.size(), bits, layout)) {
+			return false;
+		}
+		if (bits == 0) {
+			std::fill(out.begin(), out.end(), 0);
+			return true;
+		}
+		withBits(bits, [&]<unsigned Bits>(std::integral_constant<unsigned, Bits>) {
+			// When the width divides 64 both layouts are the same.
+			if (layout == Layout::PADDED || 64 % Bits == 0) {
+				unpackPadded<Bits>(words, out);
+			} else {
+				unpackSpanning<Bits>(words, out);
+			}
+		});
+		return true;
+	}
+
+	template <unsigned Bits, typename Words>
+	static void unpackPadded(const Words& words, std::span<uint16_t> out) {
+		constexpr size_t PER_LONG = 64 / Bits;
+		const size_t full = out.size() / PER_LONG;
+		auto dst = out.data();
+		for (size_t i = 0; i < full; ++i, dst += PER_LONG) {
+			const auto value = word(words, i);
+			[&]<size_t... J>(std::index_sequence<J...>) {
+				((dst[J] = field<Bits>(value, J * Bits)), ...);
+			}(std::make_index_sequence<PER_LONG>{});
+		}
+		for (size_t j = 0; j < out.size() - full * PER_LONG; ++j) {
+			dst[j] = field<Bits>(word(words, full), j * Bits);
+		}
+	}
+
+	// 64 indices of `Bits` bits fill exactly `Bits` longs, so every block of 64 has the same
+	// shifts; the block is unrolled with each of them a constant.
+	template <unsigned Bits, typename Words>
+	static void unpackSpanning(const Words& words, std::span<uint16_t> out) {
+		const size_t blocks = out.size() / 64;
+		auto dst = out.data();
+		std::array<uint64_t, Bits + 1> block{};
+		for (size_t b = 0; b < blocks; ++b, dst += 64) {
+			for (size_t i = 0; i < Bits; ++i) {
+				block[i] = word(words, b * Bits + i);
+			}
+			[&]<size_t... J>(std::index_sequence<J...>) {
+				((dst[J] = spanned<Bits, J * Bits>(block)), ...);
+			}(std::make_index_sequence<64>{});
+		}
+
+		const size_t rest = out.size() - blocks * 64;
+		const size_t used = (rest * Bits + 63) / 64;
+		block.fill(0);
+		for (size_t i = 0; i < used; ++i) {
+			block[i] = word(words, blocks * Bits + i);
+		}
+		for (size_t j = 0; j < rest; ++j) {
+			const size_t bit = j * Bits;
+			auto value = block[bit / 64] >> (bit % 64);
+			if (bit % 64 + Bits > 64) {
+				value |= block[bit / 64 + 1] << (64 - bit % 64);
+			}
+			dst[j] = field<Bits>(value, 0);
+		}
+	}
+
+	template <unsigned Bits>
+	static uint16_t field(uint64_t value, size_t shift) {
+		return static_cast<uint16_t>((value >> shift) & ((uint64_t{ 1 } << Bits) - 1));
+	}
+
+	template <unsigned Bits, size_t Bit>
+	static uint16_t spanned(const std::array<uint64_t, Bits + 1>& block) {
+		constexpr size_t SHIFT = Bit % 64;
+		auto value = block[Bit / 64] >> SHIFT;
+		if constexpr (SHIFT + Bits > 64) {
+			value |= block[Bit / 64 + 1] << (64 - SHIFT);
+		}
+		return field<Bits>(value, 0);
+	}
+
+	template <unsigned Bits>
+	static void packPadded(std::span<const uint16_t> in, std::span<uint64_t> out) {
+		constexpr size_t PER_LONG = 64 / Bits;
+		constexpr uint64_t MASK = (uint64_t{ 1 } << Bits) - 1;
+		for (size_t i = 0; i < out.size(); ++i) {
+			const size_t count = std::min(PER_LONG, in.size() - i * PER_LONG);
+			uint64_t value = 0;
+			for (size_t j = 0; j < count; ++j) {
+				value |= (uint64_t{ in[i * PER_LONG + j] } & MASK) << (j * Bits);
+			}
+			out[i] = value;
+		}
+	}
+
+	template <unsigned Bits>
+	static void packSpanning(std::span<const uint16_t> in, std::span<uint64_t> out) {
+		constexpr uint64_t MASK = (uint64_t{ 1 } << Bits) - 1;
+		std::fill(out.begin(), out.end(), 0);
+		for (size_t i = 0; i < in.size(); ++i) {
+			const size_t bit = i * Bits;
+			const unsigned shift = bit % 64;
+			const auto value = uint64_t{ in[i] } & MASK;
+			out[bit / 64] |= value << shift;
+			if (shift + Bits > 64) {
+				out[bit / 64 + 1] |= value >> (64 - shift);
+			}
+		}
+	}
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "nbt.hpp"
+#include "thread_pool.hpp"
+
+#include <atomic>
+
+// Two-phase decoder for single large documents. Any compound, or list of compounds or
+// lists, whose payload is at least `grain` bytes is first pre-scanned with skipTag() to
+// find its elements; the elements are then decoded on the pool in batches of about `grain`
+// bytes and stitched back together in order. Large elements are split again, so a big
+// list nested a few levels down is still spread over every core.
+//
+// `resource` is used from several threads at once and must be thread-safe, such as the
+// default resource or a std::pmr::synchronized_pool_resource.
+struct ParallelReader {
+	using ID = NBTFile::ID;
+
+	static constexpr size_t MAX_SPLIT_DEPTH = 8;
+
+	explicit ParallelReader(ThreadPool& pool, std::pmr::memory_resource* resource = std::pmr::get_default_resource(), NameInterner* names = nullptr, size_t grain = 256 * 1024)
+		: pool(pool), resource(resource), names(names), grain(std::max<size_t>(grain, 1)) {}
+
+	// Same result as NBTFile::read().
+	std::optional<CompoundTag> read(std::span<const std::byte> data) {
+		NBTFile file(data);
+		if (file.readID().value_or(ID::END) != ID::COMPOUND) {
+			return std::nullopt;
+		}
+		const auto name = file.readStringView();
+		if (!name.has_value()) {
+			return std::nullopt;
+		}
+		auto tag = decode(ID::COMPOUND, data.subspan(file.position()), 0, 0);
+		if (!tag.has_value()) {
+			return std::nullopt;
+		}
+
+		CompoundTag ct{ resource };
+		ct.emplace(*name, std::move(*tag));
+		return ct;
+	}
+
+private:
+	struct Item {
+		ID id;
+		std::string_view name;
+		std::span<const std::byte> payload;
+	};
+
+	// `depth` is the number of containers around the value, `splits` how many of them were
+	// split already.
+	std::optional<Tag> decode(ID id, std::span<const std::byte> payload, size_t depth, size_t splits) {
+		if (depth >= NBTFile::MAX_DEPTH) {
+			return std::nullopt;
+		}
+		if (payload.size() >= grain && splits < MAX_SPLIT_DEPTH) {
+			if (id == ID::COMPOUND) {
+				return decodeCompound(payload, depth, splits);
+			}
+			if (id == ID::LIST) {
+				const auto element = static_cast<ID>(payload.empty() ? 0 : static_cast<int8_t>(payload[0]));
+				if (element == ID::LIST || element == ID::COMPOUND) {
+					return decodeList(payload, depth, splits);
+				}
+			}
+		}
+		return NBTFile(payload, resource, names, NBTFile::MAX_DEPTH - depth).readPayload(id);
+	}
+
+	std::optional<Tag> decodeCompound(std::span<const std::byte> payload, size_t depth, size_t splits) {
+		std::vector<Item> items{};
+		NBTFile file(payload, resource, names, NBTFile::MAX_DEPTH - depth);
+		while (true) {
+			const auto id = file.readID();
+			if (!id.has_value()) {
+				return std::nullopt;
+			}
+			if (*id == ID::END) {
+				break;
+			}
+			const auto name = file.readStringView();
+			if (!name.has_value()) {
+				return std::nullopt;
+			}
+			const auto start = file.position();
+			if (!file.skipTag(*id)) {
+				return std::nullopt;
+			}
+			items.push_back(Item{ *id, *name, payload.subspan(start, file.position() - start) });
+		}
+
+		auto values = decodeItems(items, depth + 1, splits + 1);
+		if (!values.has_value()) {
+			return std::nullopt;
+		}
+		CompoundTag::storage_type entries{ resource };
+		entries.reserve(items.size());
+		for (size_t i = 0; i < items.size(); ++i) {
+			entries.emplace_back(makeName(items[i].name), std::move(*(*values)[i]));
+		}
+		return CompoundTag(std::move(entries));
+	}
+
+	std::optional<Tag> decodeList(std::span<const std::byte> payload, size_t depth, size_t splits) {
+		NBTFile file(payload, resource, names, NBTFile::MAX_DEPTH - depth);
+		const auto element = file.readID();
+		const auto len = file.readI32();
+		if (!element.has_value() || !len.has_value() || *len < 0 || static_cast<size_t>(*len) > file.remaining()) {
+			return std::nullopt;
+		}
+
+		std::vector<Item> items{};
+		items.reserve(static_cast<size_t>(*len));
+		for (int32_t i = 0; i < *len; ++i) {
+			const auto start = file.position();
+			if (!file.skipTag(*element)) {
+				return std::nullopt;
+			}
+			items.push_back(Item{ *element, {}, payload.subspan(start, file.position() - start) });
+		}
+
+		auto values = decodeItems(items, depth + 1, splits + 1);
+		if (!values.has_value()) {
+			return std::nullopt;
+		}
+		ListTag list{ resource };
+		list.reserve(items.size());
+		for (auto& value : *values) {
+			list.emplace_back(std::move(*value));
+		}
+		return list;
+	}
+
+	std::optional<std::vector<std::optional<Tag>>> decodeItems(const std::vector<Item>& items, size_t depth, size_t splits) {
+		// Consecutive items are grouped into batches of about `grain` bytes, so small
+		// elements are not scheduled one by one.
+		std::vector<size_t> batches{ 0 };
+		size_t bytes = 0;
+		for (size_t i = 0; i < items.size(); ++i) {
+			bytes += items[i].payload.size();
+			if (bytes >= grain && i + 1 < items.size()) {
+				batches.push_back(i + 1);
+				bytes = 0;
+			}
+		}
+		batches.push_back(items.size());
+
+		std::vector<std::optional<Tag>> values(items.size());
+		std::atomic<bool> failed = false;
+		pool.parallelFor(batches.size() - 1, [&](size_t batch) {
+			for (size_t i = batches[batch]; i < batches[batch + 1] && !failed; ++i) {
+				values[i] = decode(items[i].id, items[i].payload, depth, splits);
+				if (!values[i].has_value()) {
+					failed = true;
+				}
+			}
+		});
+		if (failed) {
+			return std::nullopt;
+		}
+		return values;
+	}
+
+	TagName makeName(std::string_view name) {
+		if (names != nullptr) {
+			if (auto interned = names->intern(name)) {
+				return TagName::interned(*interned);
+			}
+		}
+		return TagName(name, resource);
+	}
+
+	ThreadPool& pool;
+	std::pmr::memory_resource* resource;
+	NameInterner* names;
+	size_t grain;
+};
@@ -0,0 +1,337 @@
+#pragma once
+
+#include "nbt.hpp"
+
+#include <memory>
+
+// Immutable tag trees with shared subtrees, for undo histories and snapshots. Copying
+// any of these types copies one shared_ptr, and an update returns a new tree that shares
+// everything except the compounds and lists on the path to the change, which are copied
+// one level deep. Trees are never modified after construction, so snapshots can be read
+// from any number of threads.
+struct PersistentTag;
+struct PersistentList;
+struct PersistentCompound;
+
+struct PersistentList {
+	PersistentList() = default;
+	explicit PersistentList(std::vector<PersistentTag> elements);
+
+	size_t size() const;
+	bool empty() const;
+	const PersistentTag& operator[](size_t i) const;
+	const PersistentTag* begin() const;
+	const PersistentTag* end() const;
+
+	PersistentList set(size_t i, PersistentTag value) const;
+	PersistentList push_back(PersistentTag value) const;
+
+private:
+	std::shared_ptr<const std::vector<PersistentTag>> elements{};
+};
+
+struct PersistentCompound {
+	using value_type = std::pair<std::string, PersistentTag>;
+
+	PersistentCompound() = default;
+	// Entries are sorted by name; the first of any duplicate names is kept.
+	explicit PersistentCompound(std::vector<value_type> entries);
+
+	size_t size() const;
+	bool empty() const;
+	const value_type* begin() const;
+	const value_type* end() const;
+
+	const PersistentTag* find(std::string_view name) const;
+	bool contains(std::string_view name) const;
+
+	PersistentCompound set(std::string_view name, PersistentTag value) const;
+	PersistentCompound erase(std::string_view name) const;
+
+	// Dot-separated paths through nested compounds, such as "Level.LastUpdate". update()
+	// creates missing compounds on the way and fails if the path crosses another type.
+	const PersistentTag* findPath(std::string_view path) const;
+	std::optional<PersistentCompound> update(std::string_view path, PersistentTag value) const;
+	std::optional<PersistentCompound> erasePath(std::string_view path) const;
+
+private:
+	const value_type* lowerBound(std::string_view name) const;
+
+	std::shared_ptr<const std::vector<value_type>> entries{};
+};
+
+struct PersistentTag {
+	using ID = TagID;
+	using Node = std::variant<
+		EndTag,
+		ByteTag,
+		ShortTag,
+		IntTag,
+		LongTag,
+		FloatTag,
+		DoubleTag,
+		StringTag,
+		ByteArrayTag,
+		IntArrayTag,
+		LongArrayTag,
+		PersistentList,
+		PersistentCompound
+	>;
+
+	PersistentTag() : node(std::make_shared<const Node>(EndTag{})) {}
+
+	template <typename T> requires std::is_constructible_v<Node, T&&> && (!std::is_same_v<std::remove_cvref_t<T>, Tag>)
+	PersistentTag(T&& value) : node(std::make_shared<const Node>(std::forward<T>(value))) {}
+
+	// Converts a mutable tree; the only deep copy.
+	explicit PersistentTag(const Tag& tag);
+
+	ID id() const;
+
+	template <typename T>
+	const T* get_if() const {
+		return std::get_if<T>(node.get());
+	}
+
+	template <typename T>
+	const T& get() const {
+		return std::get<T>(*node);
+	}
+
+	// Whether both refer to the same shared subtree.
+	bool shares(const PersistentTag& other) const {
+		return node == other.node;
+	}
+
+	Tag toTag(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+private:
+	std::shared_ptr<const Node> node;
+};
+
+inline PersistentList::PersistentList(std::vector<PersistentTag> elements) : elements(std::make_shared<const std::vector<PersistentTag>>(std::move(elements))) {}
+
+inline size_t PersistentList::size() const {
+	return elements != nullptr ? elements->size() : 0;
+}
+
+inline bool PersistentList::empty() const {
+	return size() == 0;
+}
+
+inline const PersistentTag& PersistentList::operator[](size_t i) const {
+	return (*elements)[i];
+}
+
+inline const PersistentTag* PersistentList::begin() const {
+	return elements != nullptr ? elements->data() : nullptr;
+}
+
+inline const PersistentTag* PersistentList::end() const {
+	return begin() + size();
+}
+
+inline PersistentList PersistentList::set(size_t i, PersistentTag value) const {
+	std::vector<PersistentTag> copy(begin(), end());
+	copy.at(i) = std::move(value);
+	return PersistentList(std::move(copy));
+}
+
+inline PersistentList PersistentList::push_back(PersistentTag value) const {
+	std::vector<PersistentTag> copy{};
+	copy.reserve(size() + 1);
+	copy.insert(copy.end(), begin(), end());
+	copy.push_back(std::move(value));
+	return PersistentList(std::move(copy));
+}
+
+inline PersistentCompound::PersistentCompound(std::vector<value_type> entries) {
+	std::stable_sort(entries.begin(), entries.end(), [](const value_type& a, const value_type& b) {
+		return a.first < b.first;
+	});
+	auto last = std::unique(entries.begin(), entries.end(), [](const value_type& a, const value_type& b) {
+		return a.first == b.first;
+	});
+	entries.erase(last, entries.end());
+	this->entries = std::make_shared<const std::vector<value_type>>(std::move(entries));
+}
+
+inline size_t PersistentCompound::size() const {
+	return entries != nullptr ? entries->size() : 0;
+}
+
+inline bool PersistentCompound::empty() const {
+	return size() == 0;
+}
+
+inline const PersistentCompound::value_type* PersistentCompound::begin() const {
+	return entries != nullptr ? entries->data() : nullptr;
+}
+
+inline const PersistentCompound::value_type* PersistentCompound::end() const {
+	return begin() + size();
+}
+
+inline const PersistentCompound::value_type* PersistentCompound::lowerBound(std::string_view name) const {
+	return std::lower_bound(begin(), end(), name, [](const value_type& entry, std::string_view name) {
+		return entry.first < name;
+	});
+}
+
+inline const PersistentTag* PersistentCompound::find(std::string_view name) const {
+	auto it = lowerBound(name);
+	return it != end() && it->first == name ? &it->second : nullptr;
+}
+
+inline bool PersistentCompound::contains(std::string_view name) const {
+	return find(name) != nullptr;
+}
+
+inline PersistentCompound PersistentCompound::set(std::string_view name, PersistentTag value) const {
+	const auto at = lowerBound(name);
+	std::vector<value_type> copy{};
+	copy.reserve(size() + 1);
+	copy.insert(copy.end(), begin(), at);
+	copy.emplace_back(std::string(name), std::move(value));
+	copy.insert(copy.end(), at != end() && at->first == name ? at + 1 : at, end());
+
+	PersistentCompound result{};
+	result.entries = std::make_shared<const std::vector<value_type>>(std::move(copy));
+	return result;
+}
+
+inline PersistentCompound PersistentCompound::erase(std::string_view name) const {
+	const auto at = lowerBound(name);
+	if (at == end() || at->first != name) {
+		return *this;
+	}
+	std::vector<value_type> copy{};
+	copy.reserve(size() - 1);
+	copy.insert(copy.end(), begin(), at);
+	copy.insert(copy.end(), at + 1, end());
+
+	PersistentCompound result{};
+	result.entries = std::make_shared<const std::vector<value_type>>(std::move(copy));
+	return result;
+}
+
+inline const PersistentTag* PersistentCompound::findPath(std::string_view path) const {
+	const auto dot = path.find('.');
+	const auto tag = find(path.substr(0, dot));
+	if (tag == nullptr || dot == std::string_view::npos) {
+		return tag;
+	}
+	const auto compound = tag->get_if<PersistentCompound>();
+	return compound != nullptr ? compound->findPath(path.substr(dot + 1)) : nullptr;
+}
+
+inline std::optional<PersistentCompound> PersistentCompound::update(std::string_view path, PersistentTag value) const {
+	const auto dot = path.find('.');
+	const auto key = path.substr(0, dot);
+	if (dot == std::string_view::npos) {
+		return set(key, std::move(value));
+	}
+	const auto child = find(key);
+	if (child == nullptr) {
+		auto updated = PersistentCompound().update(path.substr(dot + 1), std::move(value));
+		return set(key, std::move(*updated));
+	}
+	const auto compound = child->get_if<PersistentCompound>();
+	if (compound == nullptr) {
+		return std::nullopt;
+	}
+	auto updated = compound->update(path.substr(dot + 1), std::move(value));
+	if (!updated.has_value()) {
+		return std::nullopt;
+	}
+	return set(key, std::move(*updated));
+}
+
+inline std::optional<PersistentCompound> PersistentCompound::erasePath(std::string_view path) const {
+	const auto dot = path.find('.');
+	const auto key = path.substr(0, dot);
+	if (dot == std::string_view::npos) {
+		return erase(key);
+	}
+	const auto child = find(key);
+	if (child == nullptr) {
+		return *this;
+	}
+	const auto compound = child->get_if<PersistentCompound>();
+	if (compound == nullptr) {
+		return std::nullopt;
+	}
+	auto updated = compound->erasePath(path.substr(dot + 1));
+	if (!updated.has_value()) {
+		return std::nullopt;
+	}
+	return set(key, std::move(*updated));
+}
+
+inline PersistentTag::PersistentTag(const Tag& tag) {
+	node = std::visit([]<typename T>(const T& value) -> std::shared_ptr<const Node> {
+		if constexpr (std::is_same_v<T, ListTag>) {
+			std::vector<PersistentTag> elements{};
+			elements.reserve(value.size());
+			for (const auto& element : value) {
+				elements.emplace_back(element);
+			}
+			return std::make_shared<const Node>(PersistentList(std::move(elements)));
+		} else if constexpr (std::is_same_v<T, CompoundTag>) {
+			std::vector<PersistentCompound::value_type> entries{};
+			entries.reserve(value.size());
+			for (const auto& [name, element] : value) {
+				entries.emplace_back(std::string(std::string_view(name)), PersistentTag(element));
+			}
+			return std::make_shared<const Node>(PersistentCompound(std::move(entries)));
+		} else {
+			return std::make_shared<const Node>(value);
+		}
+	}, static_cast<const Tag::variant&>(tag));
+}
+
+inline PersistentTag::ID PersistentTag::id() const {
+	static constexpr std::array<ID, std::variant_size_v<Node>> ids{
+		ID::END,
+		ID::BYTE,
+		ID::SHORT,
+		ID::INT,
+		ID::LONG,
+		ID::FLOAT,
+		ID::DOUBLE,
+		ID::STRING,
+		ID::BYTE_ARRAY,
+		ID::INT_ARRAY,
+		ID::LONG_ARRAY,
+		ID::LIST,
+		ID::COMPOUND,
+	};
+	return ids[node->index()];
+}
+
+inline Tag PersistentTag::toTag(std::pmr::memory_resource* resource) const {
+	return std::visit([&]<typename T>(const T& value) -> Tag {
+		if constexpr (std::is_same_v<T, PersistentList>) {
+			ListTag list{ resource };
+			list.reserve(value.size());
+			for (const auto& element : value) {
+				list.emplace_back(element.toTag(resource));
+			}
+			return list;
+		} else if constexpr (std::is_same_v<T, PersistentCompound>) {
+			CompoundTag::storage_type entries{ resource };
+			entries.reserve(value.size());
+			for (const auto& [name, element] : value) {
+				entries.emplace_back(TagName(name, resource), element.toTag(resource));
+			}
+			return CompoundTag(std::move(entries));
+		} else if constexpr (std::is_same_v<T, StringTag>) {
+			return StringTag{ std::pmr::string(value.value, resource) };
+		} else if constexpr (std::is_same_v<T, ByteArrayTag> || std::is_same_v<T, IntArrayTag> || std::is_same_v<T, LongArrayTag>) {
+			using E = std::remove_cvref_t<decltype(*value.begin())>;
+			return T(std::pmr::vector<E>(value.begin(), value.end(), resource));
+		} else {
+			return value;
+		}
+	}, *node);
+}
@@ -0,0 +1,288 @@
+#pragma once
+
+#include "nbt.hpp"
+#include "compression.hpp"
+#include "thread_pool.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <cstdio>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+struct RegionChunk {
+	enum class Compression : uint8_t {
+		GZIP = 1,
+		ZLIB = 2,
+		NONE = 3,
+		LZ4 = 4,
+		CUSTOM = 127,
+	};
+
+	int x = 0;
+	int z = 0;
+	Compression compression = Compression::ZLIB;
+	// Set when the payload lives in a separate c.<x>.<z>.mcc file next to the region.
+	bool external = false;
+	uint32_t timestamp = 0;
+	std::span<const std::byte> data{};
+};
+
+// An Anvil (.mca) region: a 4 KiB location table, a 4 KiB timestamp table and up to
+// 32x32 chunks stored in 4 KiB sectors. open() memory-maps the file, and chunk() returns
+// spans into the mapping, so reading a chunk copies nothing until it is decompressed.
+struct RegionFile {
+	static constexpr size_t SECTOR = 4096;
+
+	RegionFile() = default;
+	explicit RegionFile(std::span<const std::byte> data) : bytes(data) {}
+
+	RegionFile(const RegionFile&) = delete;
+	RegionFile& operator=(const RegionFile&) = delete;
+
+	RegionFile(RegionFile&& other) noexcept {
+		swap(other);
+	}
+
+	RegionFile& operator=(RegionFile&& other) noexcept {
+		RegionFile(std::move(other)).swap(*this);
+		return *this;
+	}
+
+	~RegionFile() {
+		unmap();
+	}
+
+	static std::optional<RegionFile> open(const std::filesystem::path& path) {
+		RegionFile region{};
+		if (!region.map(path)) {
+			return std::nullopt;
+		}
+		region.path = path;
+
+		int rx = 0;
+		int rz = 0;
+		if (std::sscanf(path.filename().string().c_str(), "r.%d.%d.mca", &rx, &rz) == 2) {
+			region.origin = { rx * 32, rz * 32 };
+		}
+		return region;
+	}
+
+	std::span<const std::byte> data() const {
+		return bytes;
+	}
+
+	bool contains(int x, int z) const {
+		return location(x, z).has_value();
+	}
+
+	// `x` and `z` are chunk coordinates local to the region, in [0, 32).
+	std::optional<RegionChunk> chunk(int x, int z) const {
+		const auto sectors = location(x, z);
+		if (!sectors.has_value()) {
+			return std::nullopt;
+		}
+		const auto start = sectors->first * SECTOR;
+		if (start + 5 > bytes.size()) {
+			return std::nullopt;
+		}
+		const auto length = loadBigEndian<int32_t>(bytes.data() + start);
+		if (length < 1 || static_cast<size_t>(length) > bytes.size() - start - 4) {
+			return std::nullopt;
+		}
+		const auto type = static_cast<uint8_t>(bytes[start + 4]);
+
+		RegionChunk chunk{};
+		chunk.x = x;
+		chunk.z = z;
+		chunk.compression = static_cast<RegionChunk::Compression>(type & 0x7f);
+		chunk.external = (type & 0x80) != 0;
+		chunk.timestamp = loadBigEndian<uint32_t>(bytes.data() + SECTOR + index(x, z) * 4);
+		chunk.data = bytes.subspan(start + 5, static_cast<size_t>(length) - 1);
+		return chunk;
+	}
+
+	std::optional<CompoundTag> read(int x, int z, std::pmr::memory_resource* resource = std::pmr::get_default_resource(), NameInterner* names = nullptr) const {
+		if (auto chunk = this->chunk(x, z)) {
+			return read(*chunk, resource, names);
+		}
+		return std::nullopt;
+	}
+
+	std::optional<CompoundTag> read(const RegionChunk& chunk, std::pmr::memory_resource* resource = std::pmr::get_default_resource(), NameInterner* names = nullptr) const {
+		if (chunk.compression == RegionChunk::Compression::CUSTOM) {
+			return std::nullopt;
+		}
+		if (!chunk.external) {
+			return readCompressed(chunk.data, resource, names);
+		}
+		if (path.empty()) {
+			return std::nullopt;
+		}
+
+		const auto file = path.parent_path() / ("c." + std::to_string(origin.first + chunk.x) + "." + std::to_string(origin.second + chunk.z) + ".mcc");
+		std::ifstream stream(file, std::ios::binary);
+		if (!stream) {
+			return std::nullopt;
+		}
+		std::error_code error{};
+		const auto size = std::filesystem::file_size(file, error);
+		if (error) {
+			return std::nullopt;
+		}
+		std::vector<std::byte> payload(size);
+		if (!stream.read(reinterpret_cast<char*>(payload.data()), static_cast<std::streamsize>(payload.size()))) {
+			return std::nullopt;
+		}
+		return readCompressed(payload, resource, names);
+	}
+
+	// Decompresses and parses every present chunk on `pool`; `callback(chunk, tag)` runs
+	// concurrently on the worker threads, with an empty `tag` for chunks that fail to decode.
+	template <typename F>
+	void forEachChunk(ThreadPool& pool, F&& callback, NameInterner* names = nullptr) const {
+		std::vector<RegionChunk> chunks{};
+		chunks.reserve(1024);
+		for (int z = 0; z < 32; ++z) {
+			for (int x = 0; x < 32; ++x) {
+				if (auto chunk = this->chunk(x, z)) {
+					chunks.push_back(*chunk);
+				}
+			}
+		}
+		pool.parallelFor(chunks.size(), [&](size_t i) {
+			callback(chunks[i], read(chunks[i], std::pmr::get_default_resource(), names));
+		});
+	}
+
+	template <typename F>
+	void forEachChunk(F&& callback, NameInterner* names = nullptr) const {
+		ThreadPool pool{};
+		forEachChunk(pool, std::forward<F>(callback), names);
+	}
+
+private:
+	static size_t index(int x, int z) {
+		return static_cast<size_t>((x & 31) + (z & 31) * 32);
+	}
+
+	// Returns the first sector and sector count of a chunk, if it is present.
+	std::optional<std::pair<size_t, size_t>> location(int x, int z) const {
+		if (x < 0 || x >= 32 || z < 0 || z >= 32 || bytes.size() < 2 * SECTOR) {
+			return std::nullopt;
+		}
+		const auto entry = loadBigEndian<uint32_t>(bytes.data() + index(x, z) * 4);
+		const size_t offset = entry >> 8;
+		const size_t count = entry & 0xff;
+		if (offset < 2 || count == 0) {
+			return std::nullopt;
+		}
+		return std::pair(offset, count);
+	}
+
+	bool map(const std::filesystem::path& file) {
+#if defined(_WIN32)
+		handle = CreateFileW(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+		if (handle == INVALID_HANDLE_VALUE) {
+			handle = nullptr;
+			return false;
+		}
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(handle, &size)) {
+			return false;
+		}
+		if (size.QuadPart == 0) {
+			return true;
+		}
+		mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			return false;
+		}
+		const auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr) {
+			return false;
+		}
+		bytes = { static_cast<const std::byte*>(view), static_cast<size_t>(size.QuadPart) };
+		mapped = true;
+		return true;
+#else
+		const int fd = ::open(file.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat info{};
+		if (fstat(fd, &info) != 0) {
+			::close(fd);
+			return false;
+		}
+		if (info.st_size == 0) {
+			::close(fd);
+			return true;
+		}
+		const auto view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (view == MAP_FAILED) {
+			return false;
+		}
+		madvise(view, static_cast<size_t>(info.st_size), MADV_RANDOM);
+		bytes = { static_cast<const std::byte*>(view), static_cast<size_t>(info.st_size) };
+		mapped = true;
+		return true;
+#endif
+	}
+
+	void unmap() {
+#if defined(_WIN32)
+		if (mapped) {
+			UnmapViewOfFile(bytes.data());
+		}
+		if (mapping != nullptr) {
+			CloseHandle(mapping);
+		}
+		if (handle != nullptr) {
+			CloseHandle(handle);
+		}
+		mapping = nullptr;
+		handle = nullptr;
+#else
+		if (mapped) {
+			munmap(const_cast<std::byte*>(bytes.data()), bytes.size());
+		}
+#endif
+		mapped = false;
+		bytes = {};
+	}
+
+	void swap(RegionFile& other) noexcept {
+		std::swap(bytes, other.bytes);
+		std::swap(mapped, other.mapped);
+		std::swap(path, other.path);
+		std::swap(origin, other.origin);
+#if defined(_WIN32)
+		std::swap(handle, other.handle);
+		std::swap(mapping, other.mapping);
+#endif
+	}
+
+	std::span<const std::byte> bytes{};
+	bool mapped = false;
+	std::filesystem::path path{};
+	std::pair<int, int> origin{};
+#if defined(_WIN32)
+	HANDLE handle = nullptr;
+	HANDLE mapping = nullptr;
+#endif
+};
@@ -0,0 +1,332 @@
+#pragma once
+
+#include "nbt.hpp"
+
+// Compile-time binding of NBT compounds to plain structs. A struct is bound by
+// specializing NBTSchema with a tuple of fields:
+//
+//     template <>
+//     struct NBTSchema<Section> {
+//         static constexpr auto fields = std::tuple{
+//             NBTField<"Y", &Section::y>{},
+//             NBTField<"BlockStates", &Section::states>{},
+//         };
+//     };
+//
+// The NBT type of each field follows from the member type (see NBTBinding), and the
+// decoder writes straight into the members without building a Tag tree. Keys are looked
+// up in a KeySet built from the field names at compile time; unknown keys, and keys whose
+// tag type does not match the member, are skipped and leave the member untouched.
+
+template <size_t N>
+struct FixedString {
+	constexpr FixedString(const char (&str)[N]) {
+		std::copy_n(str, N, value);
+	}
+
+	constexpr std::string_view view() const {
+		return { value, N - 1 };
+	}
+
+	char value[N]{};
+};
+
+template <typename T>
+struct NBTSchema;
+
+template <typename T>
+concept NBTBindable = requires {
+	NBTSchema<T>::fields;
+};
+
+template <typename>
+struct MemberPointer;
+
+template <typename C, typename M>
+struct MemberPointer<M C::*> {
+	using type = M;
+};
+
+template <FixedString Name, auto Member>
+struct NBTField {
+	using type = typename MemberPointer<decltype(Member)>::type;
+
+	static constexpr std::string_view name = Name.view();
+	static constexpr auto member = Member;
+};
+
+// Maps a member type to its NBT tag type and decodes its payload. Specialize it to bind
+// additional types.
+template <typename T>
+struct NBTBinding;
+
+template <typename T>
+concept NBTValue = requires(NBTFile& file, T& value) {
+	{ NBTBinding<T>::id } -> std::convertible_to<NBTFile::ID>;
+	{ NBTBinding<T>::read(file, value) } -> std::same_as<bool>;
+};
+
+template <typename T>
+bool decode(NBTFile& file, T& out);
+
+template <typename T> requires (std::is_arithmetic_v<T> || std::is_enum_v<T>)
+struct NBTBinding<T> {
+	using ID = NBTFile::ID;
+
+	static constexpr ID id = [] {
+		if constexpr (std::is_same_v<T, float>) {
+			return ID::FLOAT;
+		} else if constexpr (std::is_same_v<T, double>) {
+			return ID::DOUBLE;
+		} else if constexpr (sizeof(T) == 1) {
+			return ID::BYTE;
+		} else if constexpr (sizeof(T) == 2) {
+			return ID::SHORT;
+		} else if constexpr (sizeof(T) == 4) {
+			return ID::INT;
+		} else {
+			static_assert(sizeof(T) == 8);
+			return ID::LONG;
+		}
+	}();
+
+	static bool read(NBTFile& file, T& out) {
+		if constexpr (std::is_same_v<T, float>) {
+			return assign(file.readF32(), out);
+		} else if constexpr (std::is_same_v<T, double>) {
+			return assign(file.readF64(), out);
+		} else if constexpr (sizeof(T) == 1) {
+			return assign(file.readI8(), out);
+		} else if constexpr (sizeof(T) == 2) {
+			return assign(file.readI16(), out);
+		} else if constexpr (sizeof(T) == 4) {
+			return assign(file.readI32(), out);
+		} else {
+			return assign(file.readI64(), out);
+		}
+	}
+
+private:
+	template <typename U>
+	static bool assign(std::optional<U> value, T& out) {
+		if (!value.has_value()) {
+			return false;
+		}
+		if constexpr (std::is_same_v<T, bool>) {
+			out = *value != 0;
+		} else {
+			out = static_cast<T>(*value);
+		}
+		return true;
+	}
+};
+
+template <typename Traits, typename Allocator>
+struct NBTBinding<std::basic_string<char, Traits, Allocator>> {
+	static constexpr auto id = NBTFile::ID::STRING;
+
+	static bool read(NBTFile& file, std::basic_string<char, Traits, Allocator>& out) {
+		if (auto str = file.readStringView()) {
+			out.assign(str->data(), str->size());
+			return true;
+		}
+		return false;
+	}
+};
+
+// Vectors of 1, 4 and 8 byte integers bind to the array tags and are decoded in bulk;
+// any other element type binds to a list of that element.
+template <typename T, typename Allocator>
+struct NBTBinding<std::vector<T, Allocator>> {
+	using ID = NBTFile::ID;
+
+	static constexpr bool array = std::is_integral_v<T> && !std::is_same_v<T, bool> && (sizeof(T) == 1 || sizeof(T) == 4 || sizeof(T) == 8);
+
+	static constexpr ID id = [] {
+		if constexpr (!array) {
+			return ID::LIST;
+		} else if constexpr (sizeof(T) == 1) {
+			return ID::BYTE_ARRAY;
+		} else if constexpr (sizeof(T) == 4) {
+			return ID::INT_ARRAY;
+		} else {
+			return ID::LONG_ARRAY;
+		}
+	}();
+
+	static bool read(NBTFile& file, std::vector<T, Allocator>& out) {
+		if constexpr (array) {
+			const auto len = file.readI32();
+			if (!len.has_value() || *len < 0 || static_cast<size_t>(*len) > file.remaining() / sizeof(T)) {
+				return false;
+			}
+			const auto count = static_cast<size_t>(*len);
+			out.resize(count);
+			copyBigEndian<T>(out.data(), file.readBytes(count * sizeof(T))->data(), count);
+			return true;
+		} else {
+			const auto element = file.readID();
+			const auto len = file.readI32();
+			if (!element.has_value() || !len.has_value() || *len < 0) {
+				return false;
+			}
+			const auto count = static_cast<size_t>(*len);
+			if (count == 0) {
+				out.clear();
+				return true;
+			}
+			const auto width = std::max<size_t>(NBTFile::fixedSize(*element).value_or(1), 1);
+			if (*element == ID::END || count > file.remaining() / width) {
+				return false;
+			}
+			if (*element != NBTBinding<T>::id) {
+				if (auto size = NBTFile::fixedSize(*element)) {
+					return file.skip(count * *size);
+				}
+				for (size_t i = 0; i < count; ++i) {
+					if (!file.skipTag(*element)) {
+						return false;
+					}
+				}
+				return true;
+			}
+
+			if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>) {
+				// Fixed-width lists are stored like arrays, so they convert in one pass.
+				using I = std::conditional_t<sizeof(T) == 1, int8_t, std::conditional_t<sizeof(T) == 2, int16_t, std::conditional_t<sizeof(T) == 4, int32_t, int64_t>>>;
+				out.resize(count);
+				copyBigEndian<I>(out.data(), file.readBytes(count * sizeof(T))->data(), count);
+				return true;
+			} else if constexpr (std::is_same_v<T, bool>) {
+				// std::vector<bool> has no element references to decode into.
+				const auto bytes = *file.readBytes(count);
+				out.resize(count);
+				for (size_t i = 0; i < count; ++i) {
+					out[i] = bytes[i] != std::byte{ 0 };
+				}
+				return true;
+			} else {
+				out.clear();
+				out.resize(count);
+				for (auto& value : out) {
+					if (!decode(file, value)) {
+						return false;
+					}
+				}
+				return true;
+			}
+		}
+	}
+};
+
+// The member is engaged when the key is present.
+template <typename T>
+struct NBTBinding<std::optional<T>> {
+	static constexpr auto id = NBTBinding<T>::id;
+
+	static bool read(NBTFile& file, std::optional<T>& out) {
+		return decode(file, out.emplace());
+	}
+};
+
+// Generic tags keep the part of a document that has no schema.
+template <>
+struct NBTBinding<CompoundTag> {
+	static constexpr auto id = NBTFile::ID::COMPOUND;
+
+	static bool read(NBTFile& file, CompoundTag& out) {
+		if (auto tag = file.readTag<CompoundTag>()) {
+			out = std::move(*tag);
+			return true;
+		}
+		return false;
+	}
+};
+
+template <>
+struct NBTBinding<ListTag> {
+	static constexpr auto id = NBTFile::ID::LIST;
+
+	static bool read(NBTFile& file, ListTag& out) {
+		if (auto tag = file.readTag<ListTag>()) {
+			out = std::move(*tag);
+			return true;
+		}
+		return false;
+	}
+};
+
+template <NBTBindable T>
+struct NBTBinding<T> {
+	using ID = NBTFile::ID;
+
+	static constexpr auto id = ID::COMPOUND;
+
+	static bool read(NBTFile& file, T& out) {
+		while (true) {
+			const auto tag = file.readID();
+			if (!tag.has_value()) {
+				return false;
+			}
+			if (*tag == ID::END) {
+				return true;
+			}
+			const auto name = file.readStringView();
+			if (!name.has_value()) {
+				return false;
+			}
+
+			const auto index = keys.find(*name);
+			if (!(index.has_value() ? readers[*index](file, out, *tag) : file.skipTag(*tag))) {
+				return false;
+			}
+		}
+	}
+
+private:
+	using Fields = std::remove_const_t<decltype(NBTSchema<T>::fields)>;
+	using Reader = bool (*)(NBTFile&, T&, ID);
+
+	template <typename Field>
+	static bool readField(NBTFile& file, T& out, ID tag) {
+		using M = typename Field::type;
+		static_assert(NBTValue<M>, "member type has no NBTBinding");
+		if (tag != NBTBinding<M>::id) {
+			return file.skipTag(tag);
+		}
+		return NBTBinding<M>::read(file, out.*Field::member);
+	}
+
+	static constexpr auto keys = []<size_t... I>(std::index_sequence<I...>) {
+		return KeySet<sizeof...(I)>(std::array<std::string_view, sizeof...(I)>{ std::tuple_element_t<I, Fields>::name... });
+	}(std::make_index_sequence<std::tuple_size_v<Fields>>{});
+
+	static constexpr auto readers = []<size_t... I>(std::index_sequence<I...>) {
+		return std::array<Reader, sizeof...(I)>{ &readField<std::tuple_element_t<I, Fields>>... };
+	}(std::make_index_sequence<std::tuple_size_v<Fields>>{});
+};
+
+// Decodes the payload of a tag whose type is NBTBinding<T>::id into `out`.
+template <typename T>
+bool decode(NBTFile& file, T& out) {
+	return NBTBinding<T>::read(file, out);
+}
+
+// Reads a root compound (the TAG_Compound id and its name) straight into a T.
+template <NBTBindable T>
+std::optional<T> readAs(NBTFile& file) {
+	if (file.readID().value_or(NBTFile::ID::END) != NBTFile::ID::COMPOUND || !file.readStringView().has_value()) {
+		return std::nullopt;
+	}
+	T value{};
+	if (!decode(file, value)) {
+		return std::nullopt;
+	}
+	return value;
+}
+
+template <NBTBindable T>
+std::optional<T> readAs(std::span<const std::byte> data) {
+	NBTFile file(data);
+	return readAs<T>(file);
+}
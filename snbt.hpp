@@ -0,0 +1,698 @@
+#pragma once
+
+#include "nbt.hpp"
+
+#include <charconv>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Stringified NBT, the text form used by commands and data packs:
+// {Count:1b,id:"minecraft:stone",Pos:[1.0d,64.0d,-2.5d],data:[I;1,2,3]}
+//
+// Numbers take a type suffix (b, s, l, f, d, in either case); an integer without one is an
+// INT and a decimal without one is a DOUBLE, true and false are BYTEs, and any other
+// unquoted word is a STRING. Arrays are written [B;...], [I;...] and [L;...].
+struct SNBT {
+	// Whether `c` can appear in an unquoted key or value.
+	static bool bare(char c) {
+		return table[static_cast<unsigned char>(c)];
+	}
+
+	static bool bare(std::string_view str) {
+		return !str.empty() && std::all_of(str.begin(), str.end(), [](char c) { return bare(c); });
+	}
+
+	// First of `a`, `b` or `c` in [p, end), or `end`; compares 16 bytes at a time where SSE2
+	// or NEON is available, since quoted strings are most of the text in typical input.
+	static const char* scan(const char* p, const char* end, char a, char b, char c) {
+#if defined(__SSE2__)
+		const auto va = _mm_set1_epi8(a);
+		const auto vb = _mm_set1_epi8(b);
+		const auto vc = _mm_set1_epi8(c);
+		for (; end - p >= 16; p += 16) {
+			const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			const auto hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)), _mm_cmpeq_epi8(v, vc));
+			if (const auto mask = static_cast<unsigned>(_mm_movemask_epi8(hits)); mask != 0) {
+				return p + std::countr_zero(mask);
+			}
+		}
+#elif defined(__ARM_NEON)
+		const auto va = vdupq_n_u8(static_cast<uint8_t>(a));
+		const auto vb = vdupq_n_u8(static_cast<uint8_t>(b));
+		const auto vc = vdupq_n_u8(static_cast<uint8_t>(c));
+		for (; end - p >= 16; p += 16) {
+			const auto v = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+			const auto hits = vorrq_u8(vorrq_u8(vceqq_u8(v, va), vceqq_u8(v, vb)), vceqq_u8(v, vc));
+			// Narrows each byte to a nibble so the mask fits in one 64-bit lane.
+			const auto mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)), 0);
+			if (mask != 0) {
+				return p + std::countr_zero(mask) / 4;
+			}
+		}
+#endif
+		for (; p != end && *p != a && *p != b && *p != c; ++p) {}
+		return p;
+	}
+
+private:
+	static constexpr auto table = [] {
+		std::array<bool, 256> chars{};
+		for (auto c : std::string_view("0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_-.+")) {
+			chars[static_cast<unsigned char>(c)] = true;
+		}
+		return chars;
+	}();
+};
+
+struct SNBTReader {
+	using Error = ParseError::Kind;
+
+	static constexpr size_t MAX_DEPTH = NBTFile::MAX_DEPTH;
+
+	explicit SNBTReader(std::string_view text, std::pmr::memory_resource* resource = std::pmr::get_default_resource(), NameInterner* names = nullptr, size_t maxDepth = MAX_DEPTH)
+		: text(text), resource(resource), names(names), maxDepth(maxDepth) {}
+
+	// Starts over on new input, keeping the scratch buffer for escaped strings.
+	void reset(std::string_view input) {
+		text = input;
+		pos = 0;
+		failure.reset();
+	}
+
+	// Reads the whole input as one value; whitespace around it is allowed.
+	std::optional<Tag> read() {
+		auto tag = readValue(0);
+		if (!tag.has_value()) {
+			return std::nullopt;
+		}
+		skipSpace();
+		if (pos != text.size()) {
+			return fail(Error::INVALID_SYNTAX, pos);
+		}
+		return tag;
+	}
+
+	ParseResult<Tag> parse() {
+		if (auto tag = read()) {
+			return std::move(*tag);
+		}
+		return failure.value_or(ParseError{ Error::TRUNCATED, pos });
+	}
+
+	// The first failure since this reader was created or reset, if any.
+	std::optional<ParseError> error() const {
+		return failure;
+	}
+
+	size_t position() const {
+		return pos;
+	}
+
+private:
+	std::nullopt_t fail(Error kind, size_t offset) {
+		if (!failure.has_value()) {
+			failure = ParseError{ kind, offset };
+		}
+		return std::nullopt;
+	}
+
+	void skipSpace() {
+		while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) {
+			++pos;
+		}
+	}
+
+	bool expect(char c) {
+		skipSpace();
+		if (pos >= text.size()) {
+			fail(Error::TRUNCATED, pos);
+			return false;
+		}
+		if (text[pos] != c) {
+			fail(Error::INVALID_SYNTAX, pos);
+			return false;
+		}
+		++pos;
+		return true;
+	}
+
+	// Consumes a separating comma if there is one; a trailing comma before the closing
+	// bracket is accepted, as Minecraft does.
+	bool separator() {
+		skipSpace();
+		if (pos < text.size() && text[pos] == ',') {
+			++pos;
+			skipSpace();
+			return true;
+		}
+		return false;
+	}
+
+	std::optional<Tag> readValue(size_t depth) {
+		skipSpace();
+		if (pos >= text.size()) {
+			return fail(Error::TRUNCATED, pos);
+		}
+		switch (text[pos]) {
+			case '{':
+				return readCompound(depth + 1);
+			case '[':
+				return readList(depth + 1);
+			case '"':
+			case '\'': {
+				auto str = readQuoted();
+				if (!str.has_value()) {
+					return std::nullopt;
+				}
+				return StringTag{ std::pmr::string(*str, resource) };
+			}
+			default: {
+				const auto start = pos;
+				const auto word = readBare();
+				if (word.empty()) {
+					return fail(Error::INVALID_SYNTAX, start);
+				}
+				return classify(word);
+			}
+		}
+	}
+
+	std::string_view readBare() {
+		const auto start = pos;
+		while (pos < text.size() && SNBT::bare(text[pos])) {
+			++pos;
+		}
+		return text.substr(start, pos - start);
+	}
+
+	// Reads a quoted string at the reader's position. The result points into the input
+	// unless the string has escapes, in which case it points into `scratch`.
+	std::optional<std::string_view> readQuoted() {
+		const auto quote = text[pos];
+		const auto begin = text.data();
+		const auto end = begin + text.size();
+		auto p = SNBT::scan(begin + pos + 1, end, quote, '\\', quote);
+		if (p != end && *p == quote) {
+			const auto str = text.substr(pos + 1, static_cast<size_t>(p - begin) - pos - 1);
+			pos = static_cast<size_t>(p - begin) + 1;
+			return str;
+		}
+
+		scratch.assign(begin + pos + 1, p);
+		while (p != end && *p == '\\') {
+			pos = static_cast<size_t>(p - begin);
+			if (!unescape()) {
+				return std::nullopt;
+			}
+			const auto next = SNBT::scan(begin + pos, end, quote, '\\', quote);
+			scratch.append(begin + pos, next);
+			p = next;
+		}
+		if (p == end) {
+			return fail(Error::TRUNCATED, text.size());
+		}
+		pos = static_cast<size_t>(p - begin) + 1;
+		return std::string_view(scratch);
+	}
+
+	// Decodes the escape sequence at the reader's position into `scratch`.
+	bool unescape() {
+		const auto start = pos;
+		if (pos + 1 >= text.size()) {
+			fail(Error::TRUNCATED, text.size());
+			return false;
+		}
+		const auto c = text[pos + 1];
+		pos += 2;
+		switch (c) {
+			case '\\':
+			case '\'':
+			case '"':
+				scratch.push_back(c);
+				return true;
+			case 'b':
+				scratch.push_back('\b');
+				return true;
+			case 'f':
+				scratch.push_back('\f');
+				return true;
+			case 'n':
+				scratch.push_back('\n');
+				return true;
+			case 'r':
+				scratch.push_back('\r');
+				return true;
+			case 's':
+				scratch.push_back(' ');
+				return true;
+			case 't':
+				scratch.push_back('\t');
+				return true;
+			case 'x':
+				return unescapeCode(start, 2);
+			case 'u':
+				return unescapeCode(start, 4);
+			case 'U':
+				return unescapeCode(start, 8);
+			default:
+				fail(Error::INVALID_SYNTAX, start);
+				return false;
+		}
+	}
+
+	// Appends the code point written as `digits` hex digits, encoded as UTF-8.
+	bool unescapeCode(size_t start, size_t digits) {
+		if (pos + digits > text.size()) {
+			fail(Error::TRUNCATED, text.size());
+			return false;
+		}
+		uint32_t code = 0;
+		const auto [end, ec] = std::from_chars(text.data() + pos, text.data() + pos + digits, code, 16);
+		if (ec != std::errc{} || end != text.data() + pos + digits || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF)) {
+			fail(Error::INVALID_SYNTAX, start);
+			return false;
+		}
+		pos += digits;
+		if (code < 0x80) {
+			scratch.push_back(static_cast<char>(code));
+		} else if (code < 0x800) {
+			scratch.push_back(static_cast<char>(0xC0 | code >> 6));
+			scratch.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+		} else if (code < 0x10000) {
+			scratch.push_back(static_cast<char>(0xE0 | code >> 12));
+			scratch.push_back(static_cast<char>(0x80 | (code >> 6 & 0x3F)));
+			scratch.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+		} else {
+			scratch.push_back(static_cast<char>(0xF0 | code >> 18));
+			scratch.push_back(static_cast<char>(0x80 | (code >> 12 & 0x3F)));
+			scratch.push_back(static_cast<char>(0x80 | (code >> 6 & 0x3F)));
+			scratch.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+		}
+		return true;
+	}
+
+	std::optional<CompoundTag> readCompound(size_t depth) {
+		if (depth > maxDepth) {
+			return fail(Error::DEPTH_LIMIT, pos);
+		}
+		++pos;
+		CompoundTag::storage_type entries{ resource };
+		skipSpace();
+		while (pos < text.size() && text[pos] != '}') {
+			const auto start = pos;
+			std::optional<std::string_view> key{};
+			if (text[pos] == '"' || text[pos] == '\'') {
+				key = readQuoted();
+				if (!key.has_value()) {
+					return std::nullopt;
+				}
+			} else {
+				key = readBare();
+				if (key->empty()) {
+					return fail(Error::INVALID_SYNTAX, start);
+				}
+			}
+			// Taken before the value is read, which may reuse `scratch`.
+			auto name = makeName(*key);
+			if (!expect(':')) {
+				return std::nullopt;
+			}
+			auto tag = readValue(depth);
+			if (!tag.has_value()) {
+				return std::nullopt;
+			}
+			entries.emplace_back(std::move(name), std::move(*tag));
+			if (!separator()) {
+				break;
+			}
+		}
+		if (!expect('}')) {
+			return std::nullopt;
+		}
+		return CompoundTag(std::move(entries));
+	}
+
+	std::optional<Tag> readList(size_t depth) {
+		if (depth > maxDepth) {
+			return fail(Error::DEPTH_LIMIT, pos);
+		}
+		++pos;
+		if (pos + 1 < text.size() && text[pos + 1] == ';') {
+			switch (text[pos]) {
+				case 'B':
+					return readArray<ByteTag>();
+				case 'I':
+					return readArray<IntTag>();
+				case 'L':
+					return readArray<LongTag>();
+				default:
+					return fail(Error::INVALID_TYPE, pos);
+			}
+		}
+
+		ListTag list{ resource };
+		skipSpace();
+		while (pos < text.size() && text[pos] != ']') {
+			const auto start = pos;
+			auto tag = readValue(depth);
+			if (!tag.has_value()) {
+				return std::nullopt;
+			}
+			if (!list.empty() && tag->index() != list.begin()->index()) {
+				return fail(Error::INVALID_TYPE, start);
+			}
+			list.emplace_back(std::move(*tag));
+			if (!separator()) {
+				break;
+			}
+		}
+		if (!expect(']')) {
+			return std::nullopt;
+		}
+		return list;
+	}
+
+	// Reads the elements of [B;...], [I;...] or [L;...]; every element must be a number of
+	// the array's type.
+	template <typename T>
+	std::optional<Tag> readArray() {
+		pos += 2;
+		ArrayTag<decltype(T::value)> array{ resource };
+		skipSpace();
+		while (pos < text.size() && text[pos] != ']') {
+			const auto start = pos;
+			const auto word = readBare();
+			if (word.empty()) {
+				return fail(Error::INVALID_SYNTAX, start);
+			}
+			const auto tag = classify(word);
+			if (!std::holds_alternative<T>(tag)) {
+				return fail(Error::INVALID_TYPE, start);
+			}
+			array.emplace_back(std::get<T>(tag).value);
+			if (!separator()) {
+				break;
+			}
+		}
+		if (!expect(']')) {
+			return std::nullopt;
+		}
+		return array;
+	}
+
+	// Types an unquoted word by its suffix and shape; anything that is not a number in
+	// range or a boolean is a string, as in Minecraft.
+	Tag classify(std::string_view word) {
+		const auto suffix = static_cast<char>(word.back() | 0x20);
+		const auto body = word.substr(0, word.size() - 1);
+		switch (suffix) {
+			case 'b':
+				if (auto value = integer<int8_t>(body)) {
+					return ByteTag{ *value };
+				}
+				break;
+			case 's':
+				if (auto value = integer<int16_t>(body)) {
+					return ShortTag{ *value };
+				}
+				break;
+			case 'l':
+				if (auto value = integer<int64_t>(body)) {
+					return LongTag{ *value };
+				}
+				break;
+			case 'f':
+				if (auto value = decimal<float>(body, false)) {
+					return FloatTag{ *value };
+				}
+				break;
+			case 'd':
+				if (auto value = decimal<double>(body, false)) {
+					return DoubleTag{ *value };
+				}
+				break;
+			default:
+				break;
+		}
+		if (auto value = integer<int32_t>(word)) {
+			return IntTag{ *value };
+		}
+		if (auto value = decimal<double>(word, true)) {
+			return DoubleTag{ *value };
+		}
+		if (word.size() == 4 && (word[0] | 0x20) == 't' && (word[1] | 0x20) == 'r' && (word[2] | 0x20) == 'u' && (word[3] | 0x20) == 'e') {
+			return ByteTag{ 1 };
+		}
+		if (word.size() == 5 && (word[0] | 0x20) == 'f' && (word[1] | 0x20) == 'a' && (word[2] | 0x20) == 'l' && (word[3] | 0x20) == 's' && (word[4] | 0x20) == 'e') {
+			return ByteTag{ 0 };
+		}
+		return StringTag{ std::pmr::string(word, resource) };
+	}
+
+	// [-+]?(0|[1-9][0-9]*), in range of T.
+	template <typename T>
+	static std::optional<T> integer(std::string_view str) {
+		const bool negative = !str.empty() && str[0] == '-';
+		if (!str.empty() && (str[0] == '-' || str[0] == '+')) {
+			str.remove_prefix(1);
+		}
+		if (str.empty() || (str[0] == '0' && str.size() > 1)) {
+			return std::nullopt;
+		}
+		// Parsed as unsigned so that the most negative value is in range.
+		using U = std::make_unsigned_t<T>;
+		U magnitude = 0;
+		const auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), magnitude);
+		if (ec != std::errc{} || end != str.data() + str.size()) {
+			return std::nullopt;
+		}
+		if (magnitude > static_cast<U>(std::numeric_limits<T>::max()) + (negative ? 1u : 0u)) {
+			return std::nullopt;
+		}
+		return negative ? static_cast<T>(U{ 0 } - magnitude) : static_cast<T>(magnitude);
+	}
+
+	// [-+]?([0-9]+[.]?|[0-9]*[.][0-9]+)(e[-+]?[0-9]+)?; without a suffix the point is
+	// required, so that a plain integer stays an INT.
+	template <typename T>
+	static std::optional<T> decimal(std::string_view str, bool point) {
+		if (!str.empty() && str[0] == '+') {
+			str.remove_prefix(1);
+		}
+		size_t i = !str.empty() && str[0] == '-' ? 1 : 0;
+		const auto digits = [&] {
+			const auto start = i;
+			while (i < str.size() && str[i] >= '0' && str[i] <= '9') {
+				++i;
+			}
+			return i - start;
+		};
+		auto mantissa = digits();
+		const bool dot = i < str.size() && str[i] == '.';
+		if (dot) {
+			++i;
+			mantissa += digits();
+		}
+		if (mantissa == 0 || (point && !dot)) {
+			return std::nullopt;
+		}
+		if (i < str.size() && (str[i] | 0x20) == 'e') {
+			++i;
+			if (i < str.size() && (str[i] == '-' || str[i] == '+')) {
+				++i;
+			}
+			if (digits() == 0) {
+				return std::nullopt;
+			}
+		}
+		if (i != str.size()) {
+			return std::nullopt;
+		}
+		T value{};
+		const auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+		if (ec != std::errc{} || end != str.data() + str.size()) {
+			return std::nullopt;
+		}
+		return value;
+	}
+
+	TagName makeName(std::string_view name) {
+		if (names != nullptr) {
+			if (auto interned = names->intern(name)) {
+				return TagName::interned(*interned);
+			}
+		}
+		return TagName(name, resource);
+	}
+
+	std::string_view text{};
+	size_t pos = 0;
+	std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+	NameInterner* names = nullptr;
+	size_t maxDepth = MAX_DEPTH;
+	std::string scratch{};
+	std::optional<ParseError> failure{};
+};
+
+// Appends compact SNBT to a caller-owned string, which can be cleared and reused so that
+// printing many values allocates only while the buffer grows. Floats and doubles are
+// written in their shortest round-trip form; NaN and infinities have no SNBT spelling and
+// read back as strings. EndTag values have none either and are left out of compounds and
+// lists.
+struct SNBTWriter {
+	explicit SNBTWriter(std::string& out) : out(out) {}
+
+	void write(const Tag& tag) {
+		std::visit([&](const auto& value) { write(value); }, static_cast<const Tag::variant&>(tag));
+	}
+
+	void write(const EndTag&) {}
+
+	void write(const ByteTag& tag) {
+		number(tag.value);
+		out.push_back('b');
+	}
+
+	void write(const ShortTag& tag) {
+		number(tag.value);
+		out.push_back('s');
+	}
+
+	void write(const IntTag& tag) {
+		number(tag.value);
+	}
+
+	void write(const LongTag& tag) {
+		number(tag.value);
+		out.push_back('L');
+	}
+
+	void write(const FloatTag& tag) {
+		number(tag.value);
+		out.push_back('f');
+	}
+
+	void write(const DoubleTag& tag) {
+		number(tag.value);
+		out.push_back('d');
+	}
+
+	void write(const StringTag& tag) {
+		quote(tag.value);
+	}
+
+	void write(const ByteArrayTag& tag) {
+		array("[B;", tag, "b");
+	}
+
+	void write(const IntArrayTag& tag) {
+		array("[I;", tag, "");
+	}
+
+	void write(const LongArrayTag& tag) {
+		array("[L;", tag, "L");
+	}
+
+	void write(const ListTag& tag) {
+		out.push_back('[');
+		for (const auto& element : tag) {
+			if (std::holds_alternative<EndTag>(element)) {
+				continue;
+			}
+			write(element);
+			out.push_back(',');
+		}
+		close(']');
+	}
+
+	void write(const CompoundTag& tag) {
+		out.push_back('{');
+		for (const auto& [name, value] : tag) {
+			if (std::holds_alternative<EndTag>(value)) {
+				continue;
+			}
+			if (SNBT::bare(name.view())) {
+				out.append(name.view());
+			} else {
+				quote(name.view());
+			}
+			out.push_back(':');
+			write(value);
+			out.push_back(',');
+		}
+		close('}');
+	}
+
+	static std::string toString(const Tag& tag) {
+		std::string out{};
+		SNBTWriter(out).write(tag);
+		return out;
+	}
+
+private:
+	template <typename T>
+	void number(T value) {
+		// Enough for any integer and for the shortest form of any double.
+		constexpr size_t MAX_LENGTH = 32;
+		const auto size = out.size();
+		out.resize(size + MAX_LENGTH);
+		const auto result = std::to_chars(out.data() + size, out.data() + size + MAX_LENGTH, value);
+		out.resize(static_cast<size_t>(result.ptr - out.data()));
+	}
+
+	template <typename T>
+	void array(std::string_view open, const ArrayTag<T>& tag, std::string_view suffix) {
+		out.append(open);
+		for (auto value : tag) {
+			number(value);
+			out.append(suffix);
+			out.push_back(',');
+		}
+		close(']');
+	}
+
+	// Replaces the trailing comma, if any, with `c`.
+	void close(char c) {
+		if (out.back() == ',') {
+			out.back() = c;
+		} else {
+			out.push_back(c);
+		}
+	}
+
+	// Quotes with ' if the string has a " before any ', and with " otherwise; only the
+	// chosen quote and backslashes are escaped.
+	void quote(std::string_view str) {
+		const auto begin = str.data();
+		const auto end = begin + str.size();
+		auto p = SNBT::scan(begin, end, '"', '\'', '\\');
+		if (p == end) {
+			out.push_back('"');
+			out.append(str);
+			out.push_back('"');
+			return;
+		}
+
+		const auto first = SNBT::scan(begin, end, '"', '\'', '"');
+		const char q = first != end && *first == '"' ? '\'' : '"';
+		out.push_back(q);
+		for (auto run = begin; run != end;) {
+			p = SNBT::scan(run, end, q, '\\', q);
+			out.append(run, p);
+			if (p == end) {
+				break;
+			}
+			out.push_back('\\');
+			out.push_back(*p);
+			run = p + 1;
+		}
+		out.push_back(q);
+	}
+
+	std::string& out;
+};
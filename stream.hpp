@@ -0,0 +1,311 @@
+#pragma once
+
+#include "nbt.hpp"
+
+#include <concepts>
+#include <istream>
+
+// Anything that can refill a buffer: returns the number of bytes written to `out`, 0 at
+// the end of input, or std::nullopt on a read error. InflateStream from compression.hpp
+// qualifies, so compressed documents can be parsed while they are being decompressed.
+template <typename T>
+concept ByteSource = requires(T& source, std::span<std::byte> out) {
+	{ source.read(out) } -> std::convertible_to<std::optional<size_t>>;
+};
+
+struct SpanSource {
+	explicit SpanSource(std::span<const std::byte> data) : data(data) {}
+
+	std::optional<size_t> read(std::span<std::byte> out) {
+		const auto count = std::min(out.size(), data.size());
+		std::memcpy(out.data(), data.data(), count);
+		data = data.subspan(count);
+		return count;
+	}
+
+private:
+	std::span<const std::byte> data{};
+};
+
+struct IStreamSource {
+	explicit IStreamSource(std::istream& stream) : stream(stream) {}
+
+	std::optional<size_t> read(std::span<std::byte> out) {
+		stream.read(reinterpret_cast<char*>(out.data()), static_cast<std::streamsize>(out.size()));
+		if (stream.bad()) {
+			return std::nullopt;
+		}
+		return static_cast<size_t>(stream.gcount());
+	}
+
+private:
+	std::istream& stream;
+};
+
+// No-op event handler to derive from. Names are empty for list elements, and every
+// string_view or span passed to a callback is only valid for the duration of that call.
+// Override onScalar and onArrayChunk as templates (or provide every overload) to avoid
+// the base versions hiding narrower types.
+struct NBTHandler {
+	using ID = NBTFile::ID;
+
+	void onCompoundBegin(std::string_view) {}
+	void onCompoundEnd() {}
+	void onListBegin(std::string_view, ID, size_t) {}
+	void onListEnd() {}
+	void onArrayBegin(std::string_view, ID, size_t) {}
+	void onArrayEnd() {}
+	void onString(std::string_view, std::string_view) {}
+
+	template <typename T>
+	void onScalar(std::string_view, T) {}
+
+	template <typename T>
+	void onArrayChunk(std::span<const T>) {}
+};
+
+// Event-driven parser for documents that do not fit in memory. Input is pulled from the
+// source into a fixed window, arrays are delivered in bounded chunks, and nesting is
+// tracked on an explicit stack, so memory use is independent of document size.
+template <ByteSource Source>
+struct NBTStreamReader {
+	using ID = NBTFile::ID;
+
+	static constexpr size_t MIN_BUFFER = 64 * 1024 + 16;
+
+	explicit NBTStreamReader(Source& source, size_t bufferSize = 256 * 1024, size_t maxDepth = NBTFile::MAX_DEPTH)
+		: source(source), buffer(std::max(bufferSize, MIN_BUFFER)), scratch(buffer.size() / 8), maxDepth(maxDepth) {
+		name.reserve(UINT16_MAX);
+		stack.reserve(std::min<size_t>(maxDepth, 64));
+	}
+
+	// Drops any buffered input and starts over, keeping the buffers; for reading the next
+	// document after the source has been pointed at it.
+	void reset() {
+		stack.clear();
+		begin = 0;
+		end = 0;
+		consumed = 0;
+		tag = 0;
+	}
+
+	// Total bytes consumed from the source so far. After a failed parse this is somewhere
+	// inside the tag that could not be decoded; tagPosition() is where it starts.
+	size_t position() const {
+		return consumed + begin;
+	}
+
+	// Offset of the tag being decoded: the type byte of a compound entry, or the first byte
+	// of a list element. After a failed parse this is the tag that could not be decoded.
+	size_t tagPosition() const {
+		return tag;
+	}
+
+	template <typename Handler>
+	bool parse(Handler& handler) {
+		tag = position();
+		if (!ensure(3) || take<int8_t>() != static_cast<int8_t>(ID::COMPOUND)) {
+			return false;
+		}
+		if (!readName()) {
+			return false;
+		}
+		handler.onCompoundBegin(std::string_view(name));
+		stack.push_back(Frame{ ID::COMPOUND, ID::END, 0 });
+
+		while (!stack.empty()) {
+			auto& top = stack.back();
+			ID id = top.element;
+			tag = position();
+
+			if (top.kind == ID::COMPOUND) {
+				if (!ensure(1)) {
+					return false;
+				}
+				id = static_cast<ID>(take<int8_t>());
+				if (id == ID::END) {
+					stack.pop_back();
+					handler.onCompoundEnd();
+					continue;
+				}
+				if (!readName()) {
+					return false;
+				}
+			} else {
+				if (top.remaining == 0) {
+					stack.pop_back();
+					handler.onListEnd();
+					continue;
+				}
+				--top.remaining;
+				name.clear();
+			}
+
+			if (!value(handler, id)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	struct Frame {
+		ID kind;
+		ID element;
+		size_t remaining;
+	};
+
+	template <typename Handler>
+	bool value(Handler& handler, ID id) {
+		const std::string_view key = name;
+		switch (id) {
+			case ID::BYTE:
+				return scalar<int8_t>(handler, key);
+			case ID::SHORT:
+				return scalar<int16_t>(handler, key);
+			case ID::INT:
+				return scalar<int32_t>(handler, key);
+			case ID::LONG:
+				return scalar<int64_t>(handler, key);
+			case ID::FLOAT:
+				return scalar<float>(handler, key);
+			case ID::DOUBLE:
+				return scalar<double>(handler, key);
+			case ID::BYTE_ARRAY:
+				return array<int8_t>(handler, key, id);
+			case ID::INT_ARRAY:
+				return array<int32_t>(handler, key, id);
+			case ID::LONG_ARRAY:
+				return array<int64_t>(handler, key, id);
+			case ID::STRING: {
+				if (!ensure(2)) {
+					return false;
+				}
+				const size_t length = take<uint16_t>();
+				if (!ensure(length)) {
+					return false;
+				}
+				handler.onString(key, std::string_view(reinterpret_cast<const char*>(buffer.data() + begin), length));
+				begin += length;
+				return true;
+			}
+			case ID::LIST: {
+				if (stack.size() >= maxDepth || !ensure(5)) {
+					return false;
+				}
+				const auto element = static_cast<ID>(take<int8_t>());
+				const auto count = take<int32_t>();
+				if (count < 0 || (element == ID::END && count != 0) || element < ID::END || element > ID::LONG_ARRAY) {
+					return false;
+				}
+				handler.onListBegin(key, element, static_cast<size_t>(count));
+				stack.push_back(Frame{ ID::LIST, element, static_cast<size_t>(count) });
+				return true;
+			}
+			case ID::COMPOUND:
+				if (stack.size() >= maxDepth) {
+					return false;
+				}
+				handler.onCompoundBegin(key);
+				stack.push_back(Frame{ ID::COMPOUND, ID::END, 0 });
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	template <typename T, typename Handler>
+	bool scalar(Handler& handler, std::string_view key) {
+		if (!ensure(sizeof(T))) {
+			return false;
+		}
+		handler.onScalar(key, take<T>());
+		return true;
+	}
+
+	template <typename T, typename Handler>
+	bool array(Handler& handler, std::string_view key, ID id) {
+		if (!ensure(4)) {
+			return false;
+		}
+		const auto count = take<int32_t>();
+		if (count < 0) {
+			return false;
+		}
+		handler.onArrayBegin(key, id, static_cast<size_t>(count));
+
+		auto values = reinterpret_cast<T*>(scratch.data());
+		const auto capacity = scratch.size() * sizeof(uint64_t) / sizeof(T);
+		for (auto remaining = static_cast<size_t>(count); remaining != 0;) {
+			if (!ensure(sizeof(T))) {
+				return false;
+			}
+			const auto chunk = std::min({ remaining, (end - begin) / sizeof(T), capacity });
+			copyBigEndian<T>(values, buffer.data() + begin, chunk);
+			begin += chunk * sizeof(T);
+			remaining -= chunk;
+			handler.onArrayChunk(std::span<const T>(values, chunk));
+		}
+		handler.onArrayEnd();
+		return true;
+	}
+
+	bool readName() {
+		if (!ensure(2)) {
+			return false;
+		}
+		const size_t length = take<uint16_t>();
+		if (!ensure(length)) {
+			return false;
+		}
+		name.assign(reinterpret_cast<const char*>(buffer.data() + begin), length);
+		begin += length;
+		return true;
+	}
+
+	template <typename T>
+	T take() {
+		T value;
+		if constexpr (std::is_floating_point_v<T>) {
+			using I = std::conditional_t<sizeof(T) == 4, int32_t, int64_t>;
+			value = std::bit_cast<T>(loadBigEndian<I>(buffer.data() + begin));
+		} else {
+			value = loadBigEndian<T>(buffer.data() + begin);
+		}
+		begin += sizeof(T);
+		return value;
+	}
+
+	// Makes at least `count` bytes available at `begin`, compacting and refilling the window.
+	bool ensure(size_t count) {
+		if (end - begin >= count) {
+			return true;
+		}
+		if (count > buffer.size()) {
+			return false;
+		}
+		std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+		consumed += begin;
+		end -= begin;
+		begin = 0;
+		while (end < count) {
+			auto produced = source.read(std::span(buffer).subspan(end));
+			if (!produced.has_value() || *produced == 0) {
+				return false;
+			}
+			end += *produced;
+		}
+		return true;
+	}
+
+	Source& source;
+	std::vector<std::byte> buffer;
+	std::vector<uint64_t> scratch;
+	std::string name{};
+	std::vector<Frame> stack{};
+	size_t maxDepth;
+	size_t begin = 0;
+	size_t end = 0;
+	size_t consumed = 0;
+	size_t tag = 0;
+};
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <algorithm>
+
+// Work-stealing pool: every worker owns a queue, tasks submitted from a worker go to its
+// own queue, and idle workers take work from the others, so nested parallelFor calls keep
+// every thread busy without a single contended queue.
+struct ThreadPool {
+	explicit ThreadPool(size_t threads = std::thread::hardware_concurrency()) {
+		threads = std::max<size_t>(threads, 1);
+		queues.reserve(threads);
+		for (size_t i = 0; i < threads; ++i) {
+			queues.push_back(std::make_unique<Queue>());
+		}
+		workers.reserve(threads);
+		for (size_t i = 0; i < threads; ++i) {
+			workers.emplace_back([this, i] { run(i); });
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	~ThreadPool() {
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		available.notify_all();
+		for (auto& worker : workers) {
+			worker.join();
+		}
+	}
+
+	size_t size() const {
+		return workers.size();
+	}
+
+	// Whether the calling thread is one of this pool's workers.
+	bool onWorker() const {
+		return current.pool == this;
+	}
+
+	void submit(std::function<void()> task) {
+		const auto index = current.pool == this ? current.index : next++ % queues.size();
+		// Counted before it is queued, so `pending` never drops below the number of tasks
+		// that are still waiting in some queue.
+		{
+			std::lock_guard lock(mutex);
+			++pending;
+		}
+		{
+			std::lock_guard lock(queues[index]->mutex);
+			queues[index]->tasks.push_back(std::move(task));
+		}
+		available.notify_one();
+	}
+
+	// Calls `f(i)` for every i in [0, count) across the pool and the calling thread, and
+	// returns once all calls have finished. The first exception thrown by `f` is rethrown.
+	template <typename F>
+	void parallelFor(size_t count, F&& f) {
+		struct State {
+			std::atomic<size_t> next = 0;
+			std::atomic<size_t> done = 0;
+			std::exception_ptr error{};
+			std::mutex mutex{};
+			std::condition_variable finished{};
+		};
+		// Shared with the helper tasks, which may only start after this call has returned
+		// when every worker is busy; by then they find no work left and exit.
+		auto state = std::make_shared<State>();
+
+		auto drain = [state, count, &f] {
+			size_t completed = 0;
+			for (size_t i = state->next++; i < count; i = state->next++) {
+				try {
+					f(i);
+				} catch (...) {
+					std::lock_guard lock(state->mutex);
+					if (!state->error) {
+						state->error = std::current_exception();
+					}
+				}
+				++completed;
+			}
+			if (completed != 0 && state->done.fetch_add(completed) + completed == count) {
+				std::lock_guard lock(state->mutex);
+				state->finished.notify_all();
+			}
+		};
+
+		const auto helpers = std::min(count, workers.size());
+		for (size_t i = 0; i < helpers; ++i) {
+			submit(drain);
+		}
+		drain();
+
+		std::unique_lock lock(state->mutex);
+		state->finished.wait(lock, [&] { return state->done == count; });
+		if (state->error) {
+			std::rethrow_exception(state->error);
+		}
+	}
+
+private:
+	struct Queue {
+		std::mutex mutex{};
+		std::deque<std::function<void()>> tasks{};
+	};
+
+	struct Worker {
+		ThreadPool* pool;
+		size_t index;
+	};
+
+	// Newest task from the worker's own queue (it is likely still in cache), otherwise the
+	// oldest task of another queue.
+	std::function<void()> take(size_t self) {
+		{
+			auto& queue = *queues[self];
+			std::lock_guard lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				auto task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+				return task;
+			}
+		}
+		for (size_t i = 1; i < queues.size(); ++i) {
+			auto& queue = *queues[(self + i) % queues.size()];
+			std::lock_guard lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				auto task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+				return task;
+			}
+		}
+		return {};
+	}
+
+	void run(size_t self) {
+		current = Worker{ this, self };
+		while (true) {
+			if (auto task = take(self)) {
+				--pending;
+				task();
+				continue;
+			}
+			std::unique_lock lock(mutex);
+			available.wait(lock, [this] { return stopping || pending != 0; });
+			if (stopping && pending == 0) {
+				return;
+			}
+		}
+	}
+
+	static inline thread_local Worker current{ nullptr, 0 };
+
+	std::vector<std::unique_ptr<Queue>> queues{};
+	std::vector<std::thread> workers{};
+	std::atomic<size_t> next = 0;
+	std::atomic<size_t> pending = 0;
+	std::mutex mutex{};
+	std::condition_variable available{};
+	bool stopping = false;
+};
@@ -0,0 +1,333 @@
+#pragma once
+
+#include "nbt.hpp"
+
+// Bounds for BasicNBTValidator. The defaults suit NBT from untrusted clients, such as item
+// and book packets; maxBytes is the 2 MiB quota Minecraft itself applies to those.
+struct NBTLimits {
+	size_t maxBytes = 2 * 1024 * 1024;
+	// Compounds and lists nested in each other, the root included; at most NBTFile::MAX_DEPTH.
+	size_t maxDepth = NBTFile::MAX_DEPTH;
+	// Values, including entries and list elements but not the elements of arrays.
+	size_t maxTags = 1 << 20;
+	// Heap bytes that reading the document with NBTFile would allocate, as estimated from
+	// the sizes of the tag types.
+	size_t maxAllocation = 16 * 1024 * 1024;
+};
+
+// What a document that passed validation costs to parse.
+struct NBTUsage {
+	size_t bytes = 0;
+	size_t depth = 0;
+	size_t tags = 0;
+	size_t allocation = 0;
+};
+
+// Checks a document against NBTLimits in one linear scan that builds nothing and does not
+// allocate. NBTFile already refuses lengths that run past the end of the input, but a
+// small document can still expand a lot when it is parsed: every element of a 2 MiB list
+// of bytes becomes a Tag. Validate untrusted input first and only parse what passes.
+template <typename Format>
+struct BasicNBTValidator {
+	using ID = TagID;
+	using Error = ParseError::Kind;
+
+	explicit BasicNBTValidator(NBTLimits limits = {}) : limits(limits) {
+		this->limits.maxDepth = std::min(limits.maxDepth, NBTFile::MAX_DEPTH);
+	}
+
+	ParseResult<NBTUsage> validate(std::span<const std::byte> data) const {
+		Scan scan{ data.first(std::min(data.size(), limits.maxBytes)), data.size() > limits.maxBytes, limits };
+		if (!scan.run()) {
+			return *scan.failure;
+		}
+		return scan.usage;
+	}
+
+private:
+	struct Frame {
+		// END for compounds, otherwise the element type of a list.
+		ID element;
+		uint32_t remaining;
+	};
+
+	struct Scan {
+		std::span<const std::byte> data;
+		// Whether `data` was cut at maxBytes, so that running out of input means the limit.
+		bool clipped;
+		const NBTLimits& limits;
+		size_t pos = 0;
+		NBTUsage usage{};
+		std::optional<ParseError> failure{};
+		std::array<Frame, NBTFile::MAX_DEPTH> stack{};
+		size_t depth = 0;
+
+		bool fail(Error kind, size_t offset) {
+			failure = ParseError{ kind, offset };
+			return false;
+		}
+
+		bool truncated(size_t offset) {
+			return fail(clipped ? Error::LIMIT_EXCEEDED : Error::TRUNCATED, offset);
+		}
+
+		bool skip(size_t size) {
+			if (size > data.size() - pos) {
+				return truncated(pos);
+			}
+			pos += size;
+			return true;
+		}
+
+		bool byte(uint8_t& out) {
+			if (pos >= data.size()) {
+				return truncated(pos);
+			}
+			out = static_cast<uint8_t>(data[pos++]);
+			return true;
+		}
+
+		// Skips a varint of up to `bits` bits, returning its raw unsigned value.
+		bool varint(unsigned bits, uint64_t& out) {
+			const auto start = pos;
+			out = 0;
+			for (unsigned shift = 0; shift < bits; shift += 7) {
+				uint8_t b = 0;
+				if (!byte(b)) {
+					return truncated(start);
+				}
+				out |= static_cast<uint64_t>(b & 0x7f) << shift;
+				if ((b & 0x80) == 0) {
+					return true;
+				}
+			}
+			return fail(Error::INVALID_VARINT, start);
+		}
+
+		// A list or array length, which is a signed 32-bit value in every format.
+		bool length(size_t& out) {
+			const auto start = pos;
+			int32_t value = 0;
+			if constexpr (Format::varint) {
+				uint64_t raw = 0;
+				if (!varint(32, raw)) {
+					return false;
+				}
+				value = static_cast<int32_t>((static_cast<uint32_t>(raw) >> 1) ^ (0u - (static_cast<uint32_t>(raw) & 1)));
+			} else {
+				if (data.size() - pos < 4) {
+					return truncated(pos);
+				}
+				value = loadEndian<Format::order, int32_t>(data.data() + pos);
+				pos += 4;
+			}
+			if (value < 0) {
+				return fail(Error::INVALID_LENGTH, start);
+			}
+			out = static_cast<size_t>(value);
+			return true;
+		}
+
+		bool string(size_t& out) {
+			if constexpr (Format::varint) {
+				uint64_t raw = 0;
+				if (!varint(32, raw)) {
+					return false;
+				}
+				out = static_cast<size_t>(raw);
+			} else {
+				if (data.size() - pos < 2) {
+					return truncated(pos);
+				}
+				out = loadEndian<Format::order, uint16_t>(data.data() + pos);
+				pos += 2;
+			}
+			return skip(out);
+		}
+
+		// Heap bytes of a string of `size` characters; short ones fit in the string itself.
+		static size_t stringAllocation(size_t size) {
+			return size <= 15 ? 0 : size + 1;
+		}
+
+		static bool valid(ID id) {
+			return id <= ID::LONG_ARRAY;
+		}
+
+		bool count(size_t tags, size_t bytes) {
+			usage.tags += tags;
+			usage.allocation += bytes;
+			if (usage.tags > limits.maxTags || usage.allocation > limits.maxAllocation) {
+				return fail(Error::LIMIT_EXCEEDED, pos);
+			}
+			return true;
+		}
+
+		bool push(ID element, size_t remaining, size_t offset) {
+			if (depth >= limits.maxDepth) {
+				return fail(Error::DEPTH_LIMIT, offset);
+			}
+			stack[depth++] = Frame{ element, static_cast<uint32_t>(remaining) };
+			usage.depth = std::max(usage.depth, depth);
+			return true;
+		}
+
+		static std::optional<size_t> fixedSize(ID id) {
+			return BasicNBTFile<Format>::fixedSize(id);
+		}
+
+		// A run of `n` INT or LONG values, which are varints in varint formats.
+		bool numbers(ID id, size_t n) {
+			if constexpr (Format::varint) {
+				const unsigned bits = id == ID::INT ? 32 : 64;
+				for (size_t i = 0; i < n; ++i) {
+					uint64_t raw = 0;
+					if (!varint(bits, raw)) {
+						return false;
+					}
+				}
+				return true;
+			} else {
+				const size_t size = id == ID::INT ? 4 : 8;
+				if (n > (data.size() - pos) / size) {
+					return truncated(pos);
+				}
+				pos += n * size;
+				return true;
+			}
+		}
+
+		template <typename T>
+		bool array(ID element) {
+			size_t n = 0;
+			if (!length(n)) {
+				return false;
+			}
+			if constexpr (sizeof(T) == 1) {
+				if (!skip(n)) {
+					return false;
+				}
+			} else if (!numbers(element, n)) {
+				return false;
+			}
+			return count(0, n * sizeof(T));
+		}
+
+		bool value(ID id) {
+			const auto start = pos;
+			switch (id) {
+				case ID::BYTE:
+				case ID::SHORT:
+				case ID::FLOAT:
+				case ID::DOUBLE:
+					return skip(*fixedSize(id));
+				case ID::INT:
+				case ID::LONG:
+					return numbers(id, 1);
+				case ID::STRING: {
+					size_t size = 0;
+					return string(size) && count(0, stringAllocation(size));
+				}
+				case ID::BYTE_ARRAY:
+					return array<int8_t>(ID::BYTE);
+				case ID::INT_ARRAY:
+					return array<int32_t>(ID::INT);
+				case ID::LONG_ARRAY:
+					return array<int64_t>(ID::LONG);
+				case ID::LIST: {
+					uint8_t element = 0;
+					size_t n = 0;
+					if (!byte(element) || !length(n)) {
+						return false;
+					}
+					const auto type = static_cast<ID>(element);
+					if (!valid(type)) {
+						return fail(Error::INVALID_TYPE, start);
+					}
+					if (type == ID::END && n != 0) {
+						return fail(Error::INVALID_LENGTH, start + 1);
+					}
+					if (!count(n, n * sizeof(Tag))) {
+						return false;
+					}
+					// Lists of numbers are skipped whole; the rest are walked element by element.
+					if (const auto size = fixedSize(type)) {
+						if (*size != 0 && n > (data.size() - pos) / *size) {
+							return truncated(pos);
+						}
+						pos += n * *size;
+						return true;
+					}
+					if (type == ID::INT || type == ID::LONG) {
+						return numbers(type, n);
+					}
+					return push(type, n, start);
+				}
+				case ID::COMPOUND:
+					return push(ID::END, 0, start);
+				default:
+					return fail(Error::INVALID_TYPE, start);
+			}
+		}
+
+		bool run() {
+			uint8_t root = 0;
+			if (!byte(root)) {
+				return false;
+			}
+			if (static_cast<ID>(root) != ID::COMPOUND) {
+				return fail(Error::INVALID_TYPE, 0);
+			}
+			if constexpr (Format::namedRoot) {
+				size_t size = 0;
+				if (!string(size)) {
+					return false;
+				}
+			}
+			if (!count(1, 0) || !push(ID::END, 0, 0)) {
+				return false;
+			}
+
+			while (depth != 0) {
+				auto& top = stack[depth - 1];
+				ID id = top.element;
+				if (top.element == ID::END) {
+					uint8_t entry = 0;
+					if (!byte(entry)) {
+						return false;
+					}
+					id = static_cast<ID>(entry);
+					if (id == ID::END) {
+						--depth;
+						continue;
+					}
+					size_t size = 0;
+					if (!valid(id)) {
+						return fail(Error::INVALID_TYPE, pos - 1);
+					}
+					if (!string(size) || !count(1, sizeof(CompoundTag::value_type) + size)) {
+						return false;
+					}
+				} else {
+					if (top.remaining == 0) {
+						--depth;
+						continue;
+					}
+					--top.remaining;
+				}
+				if (!value(id)) {
+					return false;
+				}
+			}
+			usage.bytes = pos;
+			return true;
+		}
+	};
+
+	NBTLimits limits;
+};
+
+using NBTValidator = BasicNBTValidator<JavaFormat>;
+using JavaNetworkNBTValidator = BasicNBTValidator<JavaNetworkFormat>;
+using BedrockNBTValidator = BasicNBTValidator<BedrockFormat>;
+using BedrockNetworkNBTValidator = BasicNBTValidator<BedrockNetworkFormat>;